@@ -76,9 +76,11 @@
 #include <cassert>
 
 #include <boost/bind.hpp>
+#include <boost/static_assert.hpp>
 #include <boost/preprocessor/repetition/enum_params.hpp>
 #include <boost/preprocessor/repetition/enum_params_with_a_default.hpp>
 #include <boost/preprocessor/repetition/repeat.hpp>
+#include <boost/type_traits/alignment_of.hpp>
 #include <boost/type_traits/is_same.hpp>
 #include <boost/type_traits/is_member_object_pointer.hpp>
 #include <boost/mpl/apply.hpp>
@@ -285,6 +287,9 @@ namespace luabind
 
             void add_cast(class_id src, class_id target, cast_function cast);
 
+			void enable_identity_cache();
+			void enable_embedding(std::size_t size);
+
 		private:
 			class_registration* m_registration;
 		};
@@ -803,6 +808,36 @@ namespace luabind
 			);
 		}
 
+		// instances pushed from shared pointers are cached, so that
+		// pushing the same object again returns the same instance
+		class_& identity_cache()
+		{
+			this->enable_identity_cache();
+			return *this;
+		}
+
+		// instances constructed from lua hold the object in their own
+		// memory, instead of allocating it. it can't be adopted then.
+		class_& embedded()
+		{
+			BOOST_STATIC_ASSERT((
+				boost::is_same<HeldType, detail::null_type>::value));
+
+			typedef typename boost::mpl::if_<
+				boost::is_same<WrappedType, detail::null_type>
+			  , T
+			  , WrappedType
+			>::type construct_type;
+
+			typedef detail::value_holder<construct_type> holder_type;
+
+			// the storage follows the object_rep, so it may have to
+			// be padded to be aligned for the holder
+			this->enable_embedding(sizeof(holder_type)
+				+ boost::alignment_of<holder_type>::value - 1);
+			return *this;
+		}
+
 		detail::enum_maker<self_t> enum_(const char*)
 		{
 			return detail::enum_maker<self_t>(*this);
@@ -86,10 +86,11 @@ namespace std
 // no error checking.
 
 // LUABIND_NOT_THREADSAFE
-// this define will make luabind non-thread safe. That is,
-// it will rely on a static variable. You can still have
-// multiple lua states and use coroutines, but only
-// one of your real threads may run lua code.
+// this define will make luabind cache the class registry of
+// the lua state used last. The cache is kept per thread on
+// compilers that support thread local storage, otherwise
+// it's a static variable and only one of your real threads
+// may run lua code.
 
 // LUABIND_NO_EXCEPTIONS
 // this define will disable all usage of try, catch and throw in
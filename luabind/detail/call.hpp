@@ -20,19 +20,62 @@
 #  include <boost/preprocessor/repetition/enum_trailing_params.hpp>
 #  include <boost/type_traits/is_void.hpp>
 
+#  include <vector>
+
 #  include <luabind/config.hpp>
+#  include <luabind/typeid.hpp>
 #  include <luabind/detail/policy.hpp>
 #  include <luabind/yield_policy.hpp>
 
 namespace luabind { namespace detail {
 
 struct invoke_context;
+struct function_object;
+
+// maps the types of the arguments of the last calls to an overloaded
+// function to the overload they resolved to, see call_overloads().
+struct LUABIND_API overload_cache
+{
+    // the lua type of an argument, and the class and constness of
+    // luabind instances
+    struct argument_type
+    {
+        int type;
+        void const* cls;
+    };
+
+    overload_cache()
+      : next_entry(0)
+    {}
+
+    function_object const* find(argument_type const* arguments, int n) const;
+    void insert(
+        argument_type const* arguments, int n, function_object const* match);
+    void clear();
+
+    struct entry
+    {
+        entry()
+          : match(0)
+        {}
+
+        std::vector<argument_type> arguments;
+        function_object const* match;
+    };
+
+    enum { size = 4 };
+
+    entry entries[size];
+    int next_entry;
+};
 
 struct LUABIND_API function_object
 {
-    function_object(lua_CFunction entry)
+    function_object(lua_CFunction entry, bool no_throw = false)
       : entry(entry)
       , next(0)
+      , no_throw(no_throw)
+      , error_classes(0)
     {}
 
     virtual ~function_object()
@@ -41,30 +84,95 @@ struct LUABIND_API function_object
     virtual int call(
         lua_State* L, invoke_context& ctx) const = 0;
     virtual void format_signature(lua_State* L, char const* function) const = 0;
+    // identifies the signature, functions with the same one can't be
+    // told apart by overload resolution
+    virtual type_id signature_id() const = 0;
 
     lua_CFunction entry;
     std::string name;
     function_object* next;
     object keepalive;
+    // true if neither this function nor any of its overloads throw,
+    // entry doesn't catch exceptions then
+    bool no_throw;
+    // only used by the first function of an overload set
+    mutable overload_cache cache;
+    // the message of the last "no matching overload" error, and the
+    // number of classes registered when it was formatted
+    mutable object error_message;
+    mutable std::size_t error_classes;
+};
+
+// calls the overload set starting at overloads, resolving the overload
+// from the cache when the argument types have been seen before
+LUABIND_API int call_overloads(
+    lua_State* L, function_object const& overloads, invoke_context& ctx);
+
+// calls fn, and its overloads, with the arguments on the stack, like
+// its lua closure does
+LUABIND_API int call_function_object(lua_State* L, function_object const& fn);
+
+// the overloads with the best score so far. the nodes live in the
+// stack frames of invoke(), so there's no limit on their number.
+struct invoke_candidate
+{
+    function_object const* function;
+    invoke_candidate* next;
 };
 
 struct LUABIND_API invoke_context
 {
     invoke_context()
       : best_score((std::numeric_limits<int>::max)())
-      , candidate_index(0)
+      , candidates(0)
+      , last_candidate(0)
+      , candidate_count(0)
+      , match(0)
+      , single_overload(false)
     {}
 
     operator bool() const
     {
-        return candidate_index == 1;
+        return candidate_count == 1;
     }
 
+    void add_candidate(invoke_candidate& candidate, int score)
+    {
+        if (score >= 0 && score < best_score)
+        {
+            best_score = score;
+            candidates = &candidate;
+            candidate_count = 1;
+        }
+        else if (score == best_score)
+        {
+            last_candidate->next = &candidate;
+            ++candidate_count;
+        }
+        else
+        {
+            return;
+        }
+
+        last_candidate = &candidate;
+    }
+
+    // called by the last overload, while the candidates are still
+    // alive. pushes the error message if the call is ambiguous.
+    void format_ambiguity(lua_State* L) const;
+
+    // pushes the error message after a failed call. an ambiguity
+    // message has already been pushed by format_ambiguity().
     void format_error(lua_State* L, function_object const* overloads) const;
 
     int best_score;
-    function_object const* candidates[10];
-    int candidate_index;
+    invoke_candidate* candidates;
+    invoke_candidate* last_candidate;
+    int candidate_count;
+    // the overload that was called
+    function_object const* match;
+    // if set, only the first function is tried, not its overloads
+    bool single_overload;
 };
 
 template <class F, class Signature, class Policies, class IsVoid>
@@ -259,26 +367,24 @@ invoke_normal
         score = sum_scores(scores + 1, scores + 1 + N);
     }
 
-    if (score >= 0 && score < ctx.best_score)
-    {
-        ctx.best_score = score;
-        ctx.candidates[0] = &self;
-        ctx.candidate_index = 1;
-    }
-    else if (score == ctx.best_score)
-    {
-        ctx.candidates[ctx.candidate_index++] = &self;
-    }
+    invoke_candidate candidate = { &self, 0 };
+    ctx.add_candidate(candidate, score);
 
     int results = 0;
 
-    if (self.next)
+    if (self.next && !ctx.single_overload)
     {
         results = self.next->call(L, ctx);
     }
+    else if (ctx.candidate_count > 1)
+    {
+        ctx.format_ambiguity(L);
+    }
 
-    if (score == ctx.best_score && ctx.candidate_index == 1)
+    if (score == ctx.best_score && ctx.candidate_count == 1)
     {
+        ctx.match = &self;
+
 # ifndef LUABIND_INVOKE_VOID
         result_converter.apply(
             L,
@@ -37,6 +37,7 @@ namespace luabind { namespace detail
 	struct LUABIND_API class_registry
 	{
 		class_registry(lua_State* L);
+		~class_registry();
 
 		static class_registry* get_registry(lua_State* L);
 
@@ -44,6 +45,7 @@ namespace luabind { namespace detail
 		int cpp_class() const { return m_cpp_class_metatable; }
 
 		int lua_instance() const { return m_instance_metatable; }
+		int dynamic_instance() const { return m_dynamic_instance_metatable; }
 		int lua_class() const { return m_lua_class_metatable; }
 		int lua_function() const { return m_lua_function_metatable; }
 
@@ -61,10 +63,14 @@ namespace luabind { namespace detail
 		std::map<type_id, class_rep*> m_classes;
 
 		// this is a lua reference that points to the lua table
-		// that is to be used as meta table for all C++ class 
-		// instances. It is a kind of v-table.
+		// every class' instance metatable is copied from. the
+		// operators are added to the copies, by the classes.
 		int m_instance_metatable;
 
+		// the table the dynamic instance metatables are copied from,
+		// see class_rep::dynamic_metatable_ref().
+		int m_dynamic_instance_metatable;
+
 		// this is a lua reference to the metatable to be used
 		// for all classes defined in C++.
 		int m_cpp_class_metatable;
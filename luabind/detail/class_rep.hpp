@@ -25,8 +25,10 @@
 #define LUABIND_CLASS_REP_HPP_INCLUDED
 
 #include <boost/limits.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/preprocessor/repetition/enum_params_with_a_default.hpp>
 
+#include <map>
 #include <string>
 #include <utility>
 #include <vector>
@@ -48,6 +50,7 @@ namespace luabind { namespace detail
 	LUABIND_API std::string stack_content_by_name(lua_State* L, int start_index);
 
 	struct class_registration;
+	struct function_object;
 
 	struct conversion_storage;
 
@@ -121,13 +124,87 @@ namespace luabind { namespace detail
 		// the lua reference to the metatable for this class' instances
 		int metatable_ref() const throw() { return m_instance_metatable; }
 
+		// the lua reference to the metatable for instances that have
+		// members of their own, assigned from lua
+		int dynamic_metatable_ref() const throw()
+		{
+			return m_dynamic_instance_metatable;
+		}
+
 		void get_table(lua_State* L) const { m_table.push(L); }
 		void get_default_table(lua_State* L) const { m_default_table.push(L); }
 
+		// pushes the member with the key at the (absolute) stack index
+		// key_index, from either the member table or the default table.
+		// for lua classes with bases, inherited members are resolved
+		// through the base classes on demand and cached in this class'
+		// tables, instead of being copied when the class is created.
+		void get_member(lua_State* L, int key_index, bool default_table = false);
+
+		// resolves every inherited member into this class' tables.
+		// used when the complete member table is needed, e.g. by
+		// class_info().
+		void flatten_members(lua_State* L);
+
+		// must be called before reading the member tables directly, it
+		// drops any cached inherited member if a base class has been
+		// modified since they were resolved.
+		void validate_members(lua_State* L)
+		{
+			if (m_member_generation != m_generation)
+				flush_members(L);
+		}
+
+		// true if this class resolves its inherited members lazily
+		bool has_lazy_members() const
+		{
+			return m_class_type == lua_class && !m_bases.empty();
+		}
+
 		class_type get_class_type() const { return m_class_type; }
 
+		// the identity cache maps the C++ objects pushed from shared
+		// pointers to their instances, so that the same object is
+		// always pushed as the same instance. it's opt-in, see
+		// class_::identity_cache().
+		void enable_identity_cache(lua_State* L);
+
+		bool has_identity_cache() const
+		{
+			return m_identity_cache.interpreter() != 0;
+		}
+
+		// pushes the cached instance of the object at p, if there is
+		// one with the same constness. returns false otherwise, and
+		// leaves the stack unchanged.
+		bool push_cached_instance(lua_State* L, void const* p, bool pointee_const);
+
+		// caches the instance on top of the stack as the one of the
+		// object at p. instances of const and non-const objects are
+		// cached separately.
+		void cache_instance(lua_State* L, void const* p, bool pointee_const);
+
+		// pushes the __init member of the class. it's looked up once,
+		// and again after the class has been modified.
+		void push_init(lua_State* L);
+
+		// the size of the storage reserved in the instances constructed
+		// from lua, for the object itself. 0 unless the class is
+		// registered with class_::embedded().
+		std::size_t embedded_size() const { return m_embedded_size; }
+
+		// true if the class has a __finalize member, that has to be
+		// called when its instances are collected
+		bool has_finalizer() const { return m_has_finalizer; }
+
 		void add_static_constant(const char* name, int val);
 
+		typedef std::map<const char*, int, ltstr> constant_map;
+
+		// looks up a static constant in this class, and then in its
+		// bases
+		bool find_static_constant(char const* name, int& value) const;
+
 		static int super_callback(lua_State* L);
 
 		static int lua_settable_dispatcher(lua_State* L);
@@ -136,7 +213,13 @@ namespace luabind { namespace detail
 		// obj is the object pointer
 		static int static_class_gettable(lua_State* L);
 
-		bool has_operator_in_lua(lua_State*, int id);
+		// installs the operators this class defines, or inherits, as
+		// metamethods in the instance metatable
+		void update_operators(lua_State* L);
+
+		// makes the instance metatable index the member table directly,
+		// if no member lookup has to go through luabind
+		void update_instance_index(lua_State* L);
 
         cast_graph const& casts() const
         {
@@ -153,7 +236,16 @@ namespace luabind { namespace detail
 		// Code common to both constructors
 		void shared_init(lua_State * L);
 
-		void cache_operators(lua_State*);
+		// updates a single operator, in this class and in every lua
+		// class deriving from it
+		void update_operator(lua_State* L, int op);
+
+		// called when this class' tables are modified. bumps the
+		// generation of this class and every class deriving from it.
+		void invalidate_members();
+
+		// removes the cached inherited members from the tables
+		void flush_members(lua_State* L);
 
 		// this is a pointer to the type_info structure for
 		// this type
@@ -190,17 +282,57 @@ namespace luabind { namespace detail
 		// the type of this class.. determines if it's written in c++ or lua
 		class_type m_class_type;
 
+		// set when __finalize is assigned to the class, so the
+		// instances of the classes without one can be collected
+		// without looking it up
+		bool m_has_finalizer;
+
+		// the cached __init member, see push_init(). if it's a luabind
+		// function, m_init_function is its function_object, so the
+		// constructors can be called without going through lua.
+		handle m_init;
+		function_object const* m_init_function;
+
+		// see embedded_size(). lua classes get the largest size of
+		// their bases.
+		std::size_t m_embedded_size;
+
 		// this is a lua reference that points to the lua table
 		// that is to be used as meta table for all instances
-		// of this class.
+		// of this class. it holds the operators defined by the
+		// class, so it is not shared with any other class.
+		// when possible, its __index is the member table itself.
 		int m_instance_metatable;
 
-		std::map<const char*, int, ltstr> m_static_constants;
-
-		// the first time an operator is invoked
-		// we check the associated lua table
-		// and cache the result
-		int m_operator_cache;
+		// the instance metatable used once an instance has a table
+		// of its own, its __index always goes through luabind. so do
+		// its operators, they may be assigned to the instance.
+		int m_dynamic_instance_metatable;
+
+		// the static constants of the class. they belong to its
+		// registration, and are shared by the classes registered from
+		// it in every state.
+		boost::shared_ptr<constant_map const> m_static_constants;
+
+		// the lua classes deriving from this class. they are
+		// invalidated when this class is modified.
+		std::vector<class_rep*> m_derived;
+
+		// weak valued table mapping the addresses of objects to
+		// their instances, only set if the cache is enabled
+		handle m_identity_cache;
+		// the same for the instances of pointers to const
+		handle m_const_identity_cache;
+
+		// the set of keys in m_table and m_default_table that are
+		// cached copies of inherited members.
+		handle m_inherited;
+
+		// incremented every time this class, or one of its bases,
+		// is modified. m_member_generation is the generation the
+		// cached inherited members were resolved at.
+		unsigned int m_generation;
+		unsigned int m_member_generation;
 
         cast_graph* m_casts;
         class_id_map* m_classes;
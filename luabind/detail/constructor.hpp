@@ -18,6 +18,7 @@
 #  include <boost/preprocessor/iteration/local.hpp>
 #  include <boost/preprocessor/repetition/enum_params.hpp>
 #  include <boost/preprocessor/repetition/enum_binary_params.hpp>
+#  include <boost/type_traits/alignment_of.hpp>
 
 namespace luabind { namespace detail {
 
@@ -30,6 +31,24 @@ void inject_backref(lua_State* L, T* p, wrap_base*)
     weak_ref(get_main_thread(L), L, 1).swap(wrap_access::ref(*p));
 }
 
+// returns a value_holder constructed in the storage embedded in the
+// instance, if the class is registered with class_::embedded() and the
+// storage can be aligned for it. only objects owned by the default
+// holder can be embedded.
+template <class T>
+value_holder<T>* construct_embedded_holder(object_rep* self, std::auto_ptr<T>*)
+{
+    void* storage = self->allocate_embedded(
+        sizeof(value_holder<T>), boost::alignment_of<value_holder<T> >::value);
+    return storage ? new (storage) value_holder<T> : 0;
+}
+
+template <class T, class Pointer>
+value_holder<T>* construct_embedded_holder(object_rep*, Pointer*)
+{
+    return 0;
+}
+
 template <std::size_t Arity, class T, class Pointer, class Signature>
 struct construct_aux;
 
@@ -47,6 +66,15 @@ struct construct_aux<0, T, Pointer, Signature>
     {
         object_rep* self = touserdata<object_rep>(self_);
 
+        if (value_holder<T>* holder =
+                construct_embedded_holder<T>(self, (Pointer*)0))
+        {
+            T* instance = new (holder->storage()) T;
+            self->set_instance(holder);
+            inject_backref(self_.interpreter(), instance, instance);
+            return;
+        }
+
         std::auto_ptr<T> instance(new T);
         inject_backref(self_.interpreter(), instance.get(), instance.get());
 
@@ -92,6 +120,15 @@ struct construct_aux<N, T, Pointer, Signature>
     {
         object_rep* self = touserdata<object_rep>(self_);
 
+        if (value_holder<T>* holder =
+                construct_embedded_holder<T>(self, (Pointer*)0))
+        {
+            T* instance = new (holder->storage()) T(BOOST_PP_ENUM_PARAMS(N,_));
+            self->set_instance(holder);
+            inject_backref(self_.interpreter(), instance, instance);
+            return;
+        }
+
         std::auto_ptr<T> instance(new T(BOOST_PP_ENUM_PARAMS(N,_)));
         inject_backref(self_.interpreter(), instance.get(), instance.get());
 
@@ -6,10 +6,12 @@
 # define LUABIND_INHERITANCE_090217_HPP
 
 # include <cassert>
+# include <cstddef>
 # include <limits>
 # include <map>
 # include <memory>
 # include <vector>
+# include <luabind/lua_state_fwd.hpp>
 # include <luabind/typeid.hpp>
 # include <boost/scoped_ptr.hpp>
 
@@ -22,6 +24,10 @@ class_id const unknown_class = (std::numeric_limits<class_id>::max)();
 
 class class_rep;
 
+// There is one cast graph shared by every lua state. The casts between the
+// classes are the same in every state, so the states that haven't registered
+// the classes themselves may use them too. It may be used from any number of
+// threads.
 class LUABIND_API cast_graph
 {
 public:
@@ -46,27 +52,26 @@ private:
 // id-space into two, using one half for "local" ids; ids that are used only as
 // keys into the conversion cache. This is needed because we need a unique key
 // even for types that hasn't been registered explicitly.
+//
+// Every state has its own map, so it's used without locking. The local ids
+// are allocated once per type for the whole process though, since they are
+// used as keys in the cache of the shared cast graph.
 class LUABIND_API class_id_map
 {
 public:
-    class_id_map();
-
     class_id get(type_id const& type) const;
     class_id get_local(type_id const& type);
     void put(class_id id, type_id const& type);
 
 private:
+    static class_id allocate_local_id(type_id const& type);
+
     typedef std::map<type_id, class_id> map_type;
     map_type m_classes;
-    class_id m_local_id;
 
     static class_id const local_id_base;
 };
 
-inline class_id_map::class_id_map()
-  : m_local_id(local_id_base)
-{}
-
 inline class_id class_id_map::get(type_id const& type) const
 {
     map_type::const_iterator i = m_classes.find(type);
@@ -81,9 +86,7 @@ inline class_id class_id_map::get_local(type_id const& type)
         std::make_pair(type, 0));
 
     if (result.second)
-        result.first->second = m_local_id++;
-
-    assert(m_local_id >= local_id_base);
+        result.first->second = allocate_local_id(type);
 
     return result.first->second;
 }
@@ -104,16 +107,72 @@ inline void class_id_map::put(class_id id, type_id const& type)
     result.first->second = id;
 }
 
+// the cast graph shared by every state
+LUABIND_API cast_graph& shared_cast_graph();
+
 class class_map
 {
 public:
+    class_map()
+      : m_lazy(false)
+    {
+        for (std::size_t i = 0; i < dynamic_cache_size; ++i)
+            m_dynamic[i].vtable = 0;
+    }
+
     class_rep* get(class_id id) const;
     void put(class_id id, class_rep* cls);
 
+    // true if classes have been registered lazily in the state, see
+    // materialize_class()
+    bool has_lazy_classes() const { return m_lazy; }
+    void set_lazy_classes() { m_lazy = true; }
+
+    // the class id of the polymorphic objects with a vtable, and the
+    // offset to their most derived object. see get_dynamic_class_aux().
+    struct dynamic_class
+    {
+        void const* vtable;
+        class_id id;
+        std::ptrdiff_t offset;
+    };
+
+    dynamic_class const* find_dynamic(void const* vtable) const
+    {
+        dynamic_class const& entry = m_dynamic[dynamic_index(vtable)];
+        return entry.vtable == vtable ? &entry : 0;
+    }
+
+    void put_dynamic(void const* vtable, class_id id, std::ptrdiff_t offset)
+    {
+        dynamic_class& entry = m_dynamic[dynamic_index(vtable)];
+        entry.vtable = vtable;
+        entry.id = id;
+        entry.offset = offset;
+    }
+
 private:
+    enum { dynamic_cache_size = 64 };
+
+    static std::size_t dynamic_index(void const* vtable)
+    {
+        return (reinterpret_cast<std::size_t>(vtable) / sizeof(void*))
+            % dynamic_cache_size;
+    }
+
     std::vector<class_rep*> m_classes;
+    bool m_lazy;
+
+    // direct mapped, the entries are only replaced by others
+    dynamic_class m_dynamic[dynamic_cache_size];
 };
 
+// registers the class with the given id, if it has been registered
+// lazily and hasn't been looked up yet. returns its class_rep, or 0. no Lua
+// code is run, a registration that fails throws, and is done again the
+// next time the class is needed.
+LUABIND_API class_rep* materialize_class(lua_State* L, class_id id);
+
 inline class_rep* class_map::get(class_id id) const
 {
     if (id >= m_classes.size())
@@ -8,6 +8,9 @@
 # include <luabind/detail/inheritance.hpp>
 # include <luabind/get_pointer.hpp>
 # include <luabind/typeid.hpp>
+# include <boost/aligned_storage.hpp>
+# include <boost/shared_ptr.hpp>
+# include <boost/type_traits/alignment_of.hpp>
 # include <boost/type_traits/is_polymorphic.hpp>
 # include <stdexcept>
 
@@ -28,6 +31,13 @@ public:
 
     virtual void release() = 0;
 
+    // returns a pointer sharing the ownership of the held object, if
+    // it's held by a boost::shared_ptr
+    virtual boost::shared_ptr<void const> shared_owner() const
+    {
+        return boost::shared_ptr<void const>();
+    }
+
     bool pointee_const() const
     {
         return m_pointee_const;
@@ -62,6 +72,18 @@ void release_ownership(P const&)
         "luabind: smart pointer does not allow ownership transfer");
 }
 
+template <class P>
+boost::shared_ptr<void const> get_shared_owner(P const&)
+{
+    return boost::shared_ptr<void const>();
+}
+
+template <class T>
+boost::shared_ptr<void const> get_shared_owner(boost::shared_ptr<T> const& p)
+{
+    return p;
+}
+
 template <class T>
 class_id static_class_id(T*)
 {
@@ -109,6 +131,11 @@ public:
         release_ownership(p);
     }
 
+    boost::shared_ptr<void const> shared_owner() const
+    {
+        return get_shared_owner(p);
+    }
+
 private:
     mutable P p;
     // weak will hold a possibly stale pointer to the object owned
@@ -119,6 +146,53 @@ private:
     void* dynamic_ptr;
 };
 
+// holds an object of type T by value. T is constructed in storage()
+// once the holder has been constructed, and destroyed with the holder.
+template <class T>
+class value_holder : public instance_holder
+{
+public:
+    value_holder()
+      : instance_holder(false)
+    {}
+
+    ~value_holder()
+    {
+        get_pointer()->~T();
+    }
+
+    void* storage()
+    {
+        return &m_storage;
+    }
+
+    std::pair<void*, int> get(cast_graph const& casts, class_id target) const
+    {
+        return casts.cast(
+            get_pointer()
+          , registered_class<T>::id
+          , target
+          , registered_class<T>::id
+          , get_pointer()
+        );
+    }
+
+    void release()
+    {
+        throw std::runtime_error(
+            "luabind: embedded instance does not allow ownership transfer");
+    }
+
+private:
+    T* get_pointer() const
+    {
+        return static_cast<T*>(const_cast<void*>(
+            static_cast<void const*>(&m_storage)));
+    }
+
+    boost::aligned_storage<sizeof(T), boost::alignment_of<T>::value> m_storage;
+};
+
 }} // namespace luabind::detail
 
 #endif // LUABIND_INSTANCE_HOLDER_081024_HPP
@@ -9,12 +9,61 @@
 # include <luabind/detail/inheritance.hpp>
 # include <luabind/detail/object_rep.hpp>
 
+namespace boost
+{
+  template <class T> class shared_ptr;
+}
+
 namespace luabind { namespace detail {
 
+// Pointer types sharing the ownership of the pointee, the instances
+// pushed from them can be cached. See class_::identity_cache().
+template <class P>
+struct is_shared_pointer
+  : mpl::false_
+{};
+
+template <class T>
+struct is_shared_pointer<boost::shared_ptr<T> >
+  : mpl::true_
+{};
+
+// With the Itanium C++ ABI, used by GCC and Clang, the vtable pointer of
+// a polymorphic object is at its start, and determines both its dynamic
+// type and the offset to the most derived object.
+# if defined(__GXX_ABI_VERSION) && !defined(LUABIND_NO_VTABLE_CACHE)
+#  define LUABIND_VTABLE_CACHE
+# endif
+
+inline class_map& get_class_map(lua_State* L)
+{
+    lua_pushliteral(L, "__luabind_class_map");
+    lua_rawget(L, LUA_REGISTRYINDEX);
+
+    class_map& classes = *static_cast<class_map*>(lua_touserdata(L, -1));
+
+    lua_pop(L, 1);
+
+    return classes;
+}
+
 template <class T>
 std::pair<class_id, void*> get_dynamic_class_aux(
-    lua_State* L, T const* p, mpl::true_)
+    lua_State* L, class_map& classes, T const* p, mpl::true_)
 {
+# ifdef LUABIND_VTABLE_CACHE
+    void const* vtable = *reinterpret_cast<void const* const*>(p);
+
+    if (class_map::dynamic_class const* cached = classes.find_dynamic(vtable))
+    {
+        return std::make_pair(
+            cached->id
+          , const_cast<char*>(reinterpret_cast<char const*>(p))
+              + cached->offset
+        );
+    }
+# endif
+
     lua_pushliteral(L, "__luabind_class_id_map");
     lua_rawget(L, LUA_REGISTRYINDEX);
 
@@ -23,46 +72,63 @@ std::pair<class_id, void*> get_dynamic_class_aux(
 
     lua_pop(L, 1);
 
-    return std::make_pair(
+    std::pair<class_id, void*> result(
         class_ids.get_local(typeid(*p))
       , dynamic_cast<void*>(const_cast<T*>(p))
     );
+
+# ifdef LUABIND_VTABLE_CACHE
+    // the local ids of unregistered classes are replaced if the class is
+    // registered later, so only the classes of this state are cached
+    if (classes.get(result.first))
+    {
+        classes.put_dynamic(
+            vtable
+          , result.first
+          , static_cast<char*>(result.second) - reinterpret_cast<char const*>(p)
+        );
+    }
+# endif
+
+    return result;
 }
 
 template <class T>
 std::pair<class_id, void*> get_dynamic_class_aux(
-    lua_State*, T const* p, mpl::false_)
+    lua_State*, class_map&, T const* p, mpl::false_)
 {
     return std::make_pair(registered_class<T>::id, (void*)p);
 }
 
 template <class T>
-std::pair<class_id, void*> get_dynamic_class(lua_State* L, T* p)
+std::pair<class_id, void*> get_dynamic_class(
+    lua_State* L, class_map& classes, T* p)
 {
-    return get_dynamic_class_aux(L, p, boost::is_polymorphic<T>());
+    return get_dynamic_class_aux(L, classes, p, boost::is_polymorphic<T>());
 }
 
 template <class T>
-class_rep* get_pointee_class(class_map const& classes, T*)
+class_rep* get_pointee_class(lua_State* L, class_map const& classes, T*)
 {
-    return classes.get(registered_class<T>::id);
+    class_rep* cls = classes.get(registered_class<T>::id);
+
+    if (!cls && classes.has_lazy_classes())
+        cls = materialize_class(L, registered_class<T>::id);
+
+    return cls;
 }
 
 template <class P>
-class_rep* get_pointee_class(lua_State* L, P const& p, class_id dynamic_id)
+class_rep* get_pointee_class(
+    lua_State* L, class_map const& classes, P const& p, class_id dynamic_id)
 {
-    lua_pushliteral(L, "__luabind_class_map");
-    lua_rawget(L, LUA_REGISTRYINDEX);
-
-    class_map const& classes = *static_cast<class_map*>(
-        lua_touserdata(L, -1));
-
-    lua_pop(L, 1);
-
     class_rep* cls = classes.get(dynamic_id);
 
+    if (!cls && classes.has_lazy_classes())
+        cls = materialize_class(L, dynamic_id);
+
     if (!cls)
-        cls = get_pointee_class(classes, get_pointer(p));
+        cls = get_pointee_class(L, classes, get_pointer(p));
 
     return cls;
 }
@@ -71,15 +137,26 @@ class_rep* get_pointee_class(lua_State* L, P const& p, class_id dynamic_id)
 template <class P>
 void make_instance(lua_State* L, P p)
 {
-    std::pair<class_id, void*> dynamic = get_dynamic_class(L, get_pointer(p));
+    class_map& classes = get_class_map(L);
+
+    std::pair<class_id, void*> dynamic =
+        get_dynamic_class(L, classes, get_pointer(p));
 
-    class_rep* cls = get_pointee_class(L, p, dynamic.first);
+    class_rep* cls = get_pointee_class(L, classes, p, dynamic.first);
 
     if (!cls)
     {
         throw std::runtime_error("Trying to use unregistered class");
     }
 
+    bool const cached = is_shared_pointer<P>::value && cls->has_identity_cache();
+    bool const pointee_const = check_const_pointer(false ? get_pointer(p) : 0);
+
+    if (cached && cls->push_cached_instance(L, dynamic.second, pointee_const))
+    {
+        return;
+    }
+
     object_rep* instance = push_new_instance(L, cls);
 
     typedef pointer_holder<P> holder_type;
@@ -98,6 +175,9 @@ void make_instance(lua_State* L, P p)
     }
 
     instance->set_instance(static_cast<holder_type*>(storage));
+
+    if (cached)
+        cls->cache_instance(L, dynamic.second, pointee_const);
 }
 
 }} // namespace luabind::detail
@@ -0,0 +1,62 @@
+// Copyright Daniel Wallin 2009. Use, modification and distribution is
+// subject to the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef LUABIND_MUTEX_HPP_INCLUDED
+# define LUABIND_MUTEX_HPP_INCLUDED
+
+# include <luabind/config.hpp>
+# include <boost/atomic.hpp>
+# include <boost/noncopyable.hpp>
+
+namespace luabind { namespace detail {
+
+// The lock guarding the process-wide luabind state. It's a boost::atomic_flag,
+// so it works without linking to a thread library, and it's constant
+// initialized where the compiler supports it, so a lock with static storage
+// duration may be used by static constructors. A thread waiting for it spins
+// for a short while, then yields, so it may also be held while allocating.
+class mutex : boost::noncopyable
+{
+public:
+    void lock()
+    {
+        for (unsigned int spins = 0;
+            m_locked.test_and_set(boost::memory_order_acquire); ++spins)
+        {
+            wait(spins);
+        }
+    }
+
+    void unlock()
+    {
+        m_locked.clear(boost::memory_order_release);
+    }
+
+    class scoped_lock : boost::noncopyable
+    {
+    public:
+        explicit scoped_lock(mutex& m)
+          : m_mutex(m)
+        {
+            m_mutex.lock();
+        }
+
+        ~scoped_lock()
+        {
+            m_mutex.unlock();
+        }
+
+    private:
+        mutex& m_mutex;
+    };
+
+private:
+    LUABIND_API static void wait(unsigned int spins);
+
+    boost::atomic_flag m_locked;
+};
+
+}} // namespace luabind::detail
+
+#endif // LUABIND_MUTEX_HPP_INCLUDED
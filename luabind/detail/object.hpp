@@ -29,6 +29,7 @@
 #include <boost/mpl/apply_wrap.hpp>
 #include <boost/tuple/tuple.hpp>
 #include <boost/optional.hpp>
+#include <utility> // std::move
 
 #include <luabind/nil.hpp>
 #include <luabind/value_wrapper.hpp>
@@ -742,6 +743,28 @@ namespace adl
         : m_handle(other)
       {}
 
+#ifndef BOOST_NO_CXX11_RVALUE_REFERENCES
+      object(object const& other)
+        : m_handle(other.m_handle)
+      {}
+
+      object(object&& other) BOOST_NOEXCEPT
+        : m_handle(std::move(other.m_handle))
+      {}
+
+      object& operator=(object const& other)
+      {
+          m_handle = other.m_handle;
+          return *this;
+      }
+
+      object& operator=(object&& other) BOOST_NOEXCEPT
+      {
+          m_handle = std::move(other.m_handle);
+          return *this;
+      }
+#endif
+
       explicit object(from_stack const& stack_reference)
         : m_handle(stack_reference.interpreter, stack_reference.index)
       {
@@ -799,6 +822,9 @@ namespace adl
       return m_handle.interpreter() != 0;
   }
 
+  // An argument refers to a value on the Lua stack by its absolute
+  // index. Unlike object it doesn't anchor the value in the registry,
+  // so it's only valid as long as the stack slot is.
   class argument : public object_interface<argument>
   {
   public:
@@ -807,7 +833,8 @@ namespace adl
 		, m_index(stack_reference.index)
 	  {
 		  if (m_index < 0)
-			  m_index = lua_gettop(m_interpreter) - m_index + 1;
+			  m_index = lua_gettop(m_interpreter) + m_index + 1;
+		  m_type = lua_type(m_interpreter, m_index);
 	  }
 
       template<class T>
@@ -818,6 +845,9 @@ namespace adl
 
 	  void push(lua_State* L) const
 	  {
+		  assert(m_index <= lua_gettop(m_interpreter)
+			  && lua_type(m_interpreter, m_index) == m_type
+			  && "the stack slot referenced by the argument has been popped");
 		  lua_pushvalue(L, m_index);
 	  }
 
@@ -826,15 +856,27 @@ namespace adl
 		  return m_interpreter;
 	  }
 
+	  int index() const
+	  {
+		  return m_index;
+	  }
+
   private:
 	  lua_State* m_interpreter;
 	  int m_index;
+	  // the type of the value when the argument was created, only used
+	  // to check that the slot is still there. it's kept in release
+	  // builds too, so the layout doesn't depend on NDEBUG.
+	  int m_type;
   };
 
+  typedef argument stack_object;
+
 } // namespace adl
 
 using adl::object;
 using adl::argument;
+using adl::stack_object;
 
 #ifndef LUABIND_USE_VALUE_WRAPPER_TAG
 template <class ValueWrapper, class Arguments>
@@ -42,7 +42,11 @@ namespace luabind { namespace detail
 	class LUABIND_API object_rep
 	{
 	public:
-		object_rep(instance_holder* instance, class_rep* crep);
+		// embedded_size is the size of the storage that follows the
+		// object_rep in the userdata
+		object_rep(
+			instance_holder* instance, class_rep* crep
+		  , std::size_t embedded_size = 0);
 		~object_rep();
 
 		const class_rep* crep() const { return m_classrep; }
@@ -50,9 +54,17 @@ namespace luabind { namespace detail
 
 		void set_instance(instance_holder* instance) { m_instance = instance; }
 
+		// destroys the held instance, if any
+		void reset();
+
 		void add_dependency(lua_State* L, int index);
         void release_dependency_refs(lua_State* L);
 
+		// true if the instance at index has state that only lives in
+		// lua: it's an instance of a lua class, it has members of its
+		// own or it has dependencies.
+		bool has_lua_state(lua_State* L, int index) const;
+
 		std::pair<void*, int> get_instance(class_id target) const
 		{
 			if (m_instance == 0)
@@ -65,6 +77,13 @@ namespace luabind { namespace detail
 			return m_instance && m_instance->pointee_const();
 		}
 
+		boost::shared_ptr<void const> shared_owner() const
+		{
+			if (m_instance == 0)
+				return boost::shared_ptr<void const>();
+			return m_instance->shared_owner();
+		}
+
         void release()
         {
             if (m_instance)
@@ -78,15 +97,43 @@ namespace luabind { namespace detail
 			return std::malloc(size);
 		}
 
+		// returns the storage following the object_rep in the userdata,
+		// rounded up to alignment, if it's large enough, or null.
+		void* allocate_embedded(std::size_t size, std::size_t alignment)
+		{
+			char* storage = embedded_storage();
+			std::size_t const misalignment =
+				reinterpret_cast<std::size_t>(storage) % alignment;
+
+			if (misalignment != 0)
+				storage += alignment - misalignment;
+
+			if (storage + size > embedded_storage() + m_embedded_size)
+				return 0;
+			return storage;
+		}
+
 		void deallocate(void* storage)
 		{
-			if (storage == &m_instance_buffer)
+			char* p = static_cast<char*>(storage);
+
+			if (storage == &m_instance_buffer
+				|| (p >= embedded_storage()
+					&& p < embedded_storage() + m_embedded_size))
+			{
 				return;
+			}
+
 			std::free(storage);
 		}
 
 	private:
 
+	char* embedded_storage()
+	{
+		return reinterpret_cast<char*>(this + 1);
+	}
+
 	object_rep(object_rep const&)
 	{}
 
@@ -97,6 +144,10 @@ namespace luabind { namespace detail
         boost::aligned_storage<32> m_instance_buffer;
 		class_rep* m_classrep; // the class information about this object's type
         std::size_t m_dependency_cnt; // counts dependencies
+        // registry reference to the only dependency, or to a table
+        // holding all of them once there are more than one
+        int m_dependency_ref;
+        std::size_t m_embedded_size;
 	};
 
 	template<class T>
@@ -124,8 +175,9 @@ namespace luabind { namespace detail
 	};
 
     LUABIND_API object_rep* get_instance(lua_State* L, int index);
-    LUABIND_API void push_instance_metatable(lua_State* L);
-    LUABIND_API object_rep* push_new_instance(lua_State* L, class_rep* cls);
+    LUABIND_API void push_instance_metatable(lua_State* L, bool dynamic);
+    LUABIND_API object_rep* push_new_instance(
+        lua_State* L, class_rep* cls, std::size_t embedded_size = 0);
 
 }}
 
@@ -33,6 +33,14 @@ namespace detail
       virtual ~exception_handler_base() {}
       virtual void handle(lua_State*) const = 0;
 
+      // true if this handler catches the exception currently
+      // being handled
+      virtual bool can_handle() const = 0;
+
+      // handles the current exception with this handler only,
+      // without trying the rest of the chain
+      virtual void handle_current(lua_State*) const = 0;
+
       void try_next(lua_State*) const;
 
       exception_handler_base* next;
@@ -69,6 +77,34 @@ namespace detail
           }
       }
 
+      bool can_handle() const
+      {
+          try
+          {
+              throw;
+          }
+          catch (argument)
+          {
+              return true;
+          }
+          catch (...)
+          {
+              return false;
+          }
+      }
+
+      void handle_current(lua_State* L) const
+      {
+          try
+          {
+              throw;
+          }
+          catch (argument e)
+          {
+              handler(L, e);
+          }
+      }
+
       Handler handler;
   };
 
@@ -24,6 +24,7 @@
 #define LUABIND_HANDLE_050420_HPP
 
 #include <algorithm>
+#include <luabind/config.hpp>
 #include <luabind/lua_include.hpp>
 #include <luabind/value_wrapper.hpp>
 
@@ -38,9 +39,15 @@ public:
     handle(lua_State* interpreter, int stack_index);
     handle(lua_State* main, lua_State* interpreter, int stack_index);
     handle(handle const& other);
+#ifndef BOOST_NO_CXX11_RVALUE_REFERENCES
+    handle(handle&& other) BOOST_NOEXCEPT;
+#endif
     ~handle();
 
     handle& operator=(handle const& other);
+#ifndef BOOST_NO_CXX11_RVALUE_REFERENCES
+    handle& operator=(handle&& other) BOOST_NOEXCEPT;
+#endif
     void swap(handle& other);
 
     void push(lua_State* interpreter) const;
@@ -68,6 +75,18 @@ inline handle::handle(handle const& other)
     m_index = luaL_ref(m_interpreter, LUA_REGISTRYINDEX);
 }
 
+#ifndef BOOST_NO_CXX11_RVALUE_REFERENCES
+// Moving a handle takes over its registry slot instead of
+// allocating a new one.
+inline handle::handle(handle&& other) BOOST_NOEXCEPT
+  : m_interpreter(other.m_interpreter)
+  , m_index(other.m_index)
+{
+    other.m_interpreter = 0;
+    other.m_index = LUA_NOREF;
+}
+#endif
+
 inline handle::handle(lua_State* interpreter, int stack_index)
   : m_interpreter(interpreter)
   , m_index(LUA_NOREF)
@@ -96,6 +115,14 @@ inline handle& handle::operator=(handle const& other)
     return *this;
 }
 
+#ifndef BOOST_NO_CXX11_RVALUE_REFERENCES
+inline handle& handle::operator=(handle&& other) BOOST_NOEXCEPT
+{
+    swap(other);
+    return *this;
+}
+#endif
+
 inline void handle::swap(handle& other)
 {
     std::swap(m_interpreter, other.m_interpreter);
@@ -10,6 +10,7 @@
 # include <luabind/detail/call.hpp>
 # include <luabind/detail/deduce_signature.hpp>
 # include <luabind/detail/format_signature.hpp>
+# include <luabind/no_throw_policy.hpp>
 
 namespace luabind {
 
@@ -29,8 +30,11 @@ namespace detail
   template <class F, class Signature, class Policies>
   struct function_object_impl : function_object
   {
+      typedef has_policy<Policies, no_throw_policy> is_no_throw;
+
       function_object_impl(F f, Policies const& policies)
-        : function_object(&entry_point)
+        : function_object(
+              select_entry_point(is_no_throw()), is_no_throw::value)
         , f(f)
         , policies(policies)
       {}
@@ -45,6 +49,11 @@ namespace detail
           detail::format_signature(L, function, Signature());
       }
 
+      type_id signature_id() const
+      {
+          return typeid(Signature);
+      }
+
       static int entry_point(lua_State* L)
       {
           function_object_impl const* impl =
@@ -59,7 +68,7 @@ namespace detail
 
           try
           {
-              results = invoke(
+              results = impl->next ? call_overloads(L, *impl, ctx) : invoke(
                   L, *impl, ctx, impl->f, Signature(), impl->policies);
           }
           catch (...)
@@ -71,7 +80,8 @@ namespace detail
           if (exception_caught)
               lua_error(L);
 # else
-          results = invoke(L, *impl, ctx, impl->f, Signature(), impl->policies);
+          results = impl->next ? call_overloads(L, *impl, ctx) : invoke(
+              L, *impl, ctx, impl->f, Signature(), impl->policies);
 # endif
 
           if (!ctx)
@@ -83,6 +93,37 @@ namespace detail
           return results;
       }
 
+      // used for functions with the no_throw policy, the call isn't
+      // wrapped in a try block
+      static int no_throw_entry_point(lua_State* L)
+      {
+          function_object_impl const* impl =
+              *(function_object_impl const**)lua_touserdata(L, lua_upvalueindex(1));
+
+          invoke_context ctx;
+
+          int results = impl->next ? call_overloads(L, *impl, ctx) : invoke(
+              L, *impl, ctx, impl->f, Signature(), impl->policies);
+
+          if (!ctx)
+          {
+              ctx.format_error(L, impl);
+              lua_error(L);
+          }
+
+          return results;
+      }
+
+      static lua_CFunction select_entry_point(mpl::false_)
+      {
+          return &entry_point;
+      }
+
+      static lua_CFunction select_entry_point(mpl::true_)
+      {
+          return &no_throw_entry_point;
+      }
+
       F f;
       Policies policies;
   };
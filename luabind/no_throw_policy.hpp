@@ -0,0 +1,35 @@
+// Copyright Daniel Wallin 2008. Use, modification and distribution is
+// subject to the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef LUABIND_NO_THROW_POLICY_HPP_INCLUDED
+#define LUABIND_NO_THROW_POLICY_HPP_INCLUDED
+
+#include <luabind/config.hpp>
+#include <luabind/detail/policy.hpp>
+
+namespace luabind { namespace detail
+{
+	// marks functions that never throw, they are called without
+	// catching exceptions
+	struct no_throw_policy
+	{
+		static void precall(lua_State*, const index_map&) {}
+		static void postcall(lua_State*, const index_map&) {}
+	};
+}}
+
+namespace luabind
+{
+  detail::policy_cons<detail::no_throw_policy, detail::null_type> const no_throw = {};
+
+  namespace detail
+  {
+    inline void ignore_unused_no_throw()
+    {
+        (void)no_throw;
+    }
+  }
+}
+
+#endif // LUABIND_NO_THROW_POLICY_HPP_INCLUDED
@@ -47,6 +47,13 @@
 #include <sstream>
 #endif
 
+#include <ostream>
+#include <streambuf>
+#include <string>
+
+#include <luabind/config.hpp>
+#include <luabind/lua_include.hpp>
+
 namespace luabind { namespace detail {
 
     template<class W, class T> struct unwrap_parameter_type;
@@ -328,6 +335,72 @@ namespace luabind {
         return 0; \
     }
 
+namespace detail {
+
+    // a stream buffer appending to a string. it's reused for every
+    // call, so the string keeps its capacity.
+    class LUABIND_API string_buffer : public std::streambuf
+    {
+    public:
+        void clear() { m_string.clear(); }
+
+        // pushes the string written to the buffer
+        void push(lua_State* L) const;
+
+    protected:
+        int_type overflow(int_type c);
+        std::streamsize xsputn(char const* s, std::streamsize n);
+
+    private:
+        std::string m_string;
+    };
+
+    // returns the stream kept by the lua state, writing to its empty
+    // buffer and with the default format, or null if an enclosing call
+    // is using it
+    LUABIND_API std::ostream* acquire_tostring_stream(lua_State* L);
+
+    class tostring_stream_guard
+    {
+    public:
+        explicit tostring_stream_guard(std::ostream& stream)
+          : m_stream(stream)
+        {}
+
+        ~tostring_stream_guard()
+        {
+            m_stream.rdbuf(0);
+        }
+
+    private:
+        tostring_stream_guard& operator=(tostring_stream_guard const&);
+
+        std::ostream& m_stream;
+    };
+
+    // formats x with operator<<, without constructing a stream for
+    // every call. the result is only pushed once formatting is done, so
+    // operator<< may use the lua stack.
+    template<class T>
+    void push_tostring(lua_State* L, T const& x)
+    {
+        if (std::ostream* stream = acquire_tostring_stream(L))
+        {
+            tostring_stream_guard guard(*stream);
+            *stream << x;
+            static_cast<string_buffer*>(stream->rdbuf())->push(L);
+        }
+        else
+        {
+            string_buffer buffer;
+            std::ostream local_stream(&buffer);
+            local_stream << x;
+            buffer.push(L);
+        }
+    }
+
+} // namespace detail
+
     template<class T>
     std::string tostring_operator(T const& x)
     {
@@ -341,11 +414,41 @@ namespace luabind {
         return s.str();
     }
     
-    LUABIND_UNARY_OPERATOR(tostring, tostring_operator, tostring)
     LUABIND_UNARY_OPERATOR(unm, -, operator-)
 
 #undef LUABIND_UNARY_OPERATOR
 
+    namespace operators {
+
+        struct tostring
+        {
+            template<class T, class Policies>
+            struct apply
+            {
+                static void execute(lua_State* L, T x)
+                {
+                    detail::push_tostring(L, x);
+                }
+            };
+
+            static char const* name()
+            {
+                return "__tostring";
+            }
+        };
+
+    }
+
+    template<class T>
+    detail::unary_operator<
+        operators::tostring
+      , T
+    >
+    inline tostring(self_base<T>)
+    {
+        return 0;
+    }
+
     namespace {
 
         LUABIND_ANONYMOUS_FIX self_type self;
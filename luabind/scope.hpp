@@ -26,7 +26,9 @@
 #include <luabind/prefix.hpp>
 #include <luabind/config.hpp>
 #include <luabind/lua_state_fwd.hpp>
+#include <cstddef>
 #include <memory>
+#include <vector>
 
 namespace luabind { 
     
@@ -36,12 +38,27 @@ namespace luabind {
 
 namespace luabind { namespace detail {
 
+    typedef std::size_t class_id;
+
     struct LUABIND_API registration
     {
         registration();
         virtual ~registration();
 
-    protected:
+        registration const* next() const { return m_next; }
+
+        // the name this registration defines in the table it's
+        // registered in, if it can be registered lazily. see
+        // compiled_module::register_lazily().
+        virtual char const* lazy_name() const;
+
+        // for namespaces, the scope registered in the namespace table.
+        // it's registered lazily as well.
+        virtual scope const* lazy_scope() const;
+
+        // appends the ids of the classes this registration defines
+        virtual void lazy_class_ids(std::vector<class_id>& ids) const;
+
         virtual void register_(lua_State*) const = 0;
 
     private:
@@ -49,6 +66,10 @@ namespace luabind { namespace detail {
         registration* m_next;
     };
 
+    // true if the table at index has registrations left to do, see
+    // compiled_module::register_lazily()
+    LUABIND_API bool has_lazy_registrations(lua_State* L, int index);
+
 }} // namespace luabind::detail
 
 namespace luabind {
@@ -66,6 +87,8 @@ namespace luabind {
 
         void register_(lua_State* L) const;
 
+        detail::registration const* chain() const { return m_chain; }
+
     private:
         detail::registration* m_chain;
     };
@@ -97,6 +120,35 @@ namespace luabind {
         return module_(L, name);
     }
 
+    // A module whose registrations are built once, and registered in any
+    // number of lua states. Only the lua side of the bindings, the tables,
+    // functions and classes, is created for every state:
+    //
+    //     compiled_module m("test", (def("f", &f), class_<A>("A")));
+    //     m.register_(L1);
+    //     m.register_(L2);
+    class LUABIND_API compiled_module
+    {
+    public:
+        explicit compiled_module(scope s);
+        compiled_module(char const* name, scope s);
+
+        void register_(lua_State* L) const;
+
+        // only registers the functions right away. the classes and
+        // namespaces are registered the first time they are looked up,
+        // or needed to push an object. the module has to outlive the
+        // state.
+        void register_lazily(lua_State* L) const;
+
+    private:
+        compiled_module(compiled_module const&);
+        compiled_module& operator=(compiled_module const&);
+
+        scope m_scope;
+        char const* m_name;
+    };
+
 } // namespace luabind
 
 #endif // NEW_SCOPE_040211_HPP
@@ -6,6 +6,7 @@
 # define LUABIND_SHARED_PTR_CONVERTER_090211_HPP
 
 # include <luabind/detail/policy.hpp>    // for default_converter, etc
+# include <luabind/back_reference.hpp>   // for get_back_reference
 # include <luabind/get_main_thread.hpp>  // for get_main_thread
 # include <luabind/handle.hpp>           // for handle
 # include <luabind/detail/decorate_type.hpp>  // for LUABIND_DECORATE_TYPE
@@ -54,10 +55,35 @@ struct default_converter<boost::shared_ptr<T> >
             L, LUABIND_DECORATE_TYPE(T*), index);
         if (!raw_ptr)
             return boost::shared_ptr<T>();
+
+        // if the instance is held by a shared_ptr, share its ownership
+        // instead of keeping the instance alive. that's only possible if
+        // nothing is lost when the lua object is collected: wrappers
+        // need their back reference, and members set from lua need
+        // the instance.
+        detail::object_rep* instance = detail::get_instance(L, index);
+
+        if (instance && !has_back_reference(raw_ptr)
+            && !instance->has_lua_state(L, index))
+        {
+            boost::shared_ptr<void const> owner = instance->shared_owner();
+            if (owner)
+                return boost::shared_ptr<T>(owner, raw_ptr);
+        }
+
         return boost::shared_ptr<T>(
             raw_ptr, detail::shared_ptr_deleter(L, index));
     }
 
+    static bool has_back_reference(T* p)
+    {
+# ifndef LUABIND_NO_RTTI
+        return detail::get_back_reference(p) != 0;
+# else
+        return false;
+# endif
+    }
+
     void apply(lua_State* L, boost::shared_ptr<T> const& p)
     {
         if (detail::shared_ptr_deleter* d =
@@ -0,0 +1,102 @@
+// Copyright Daniel Wallin 2009. Use, modification and distribution is
+// subject to the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef LUABIND_STATE_POOL_HPP_INCLUDED
+#define LUABIND_STATE_POOL_HPP_INCLUDED
+
+#include <luabind/config.hpp>
+#include <luabind/lua_state_fwd.hpp>
+
+#include <boost/function/function1.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include <cstddef>
+
+namespace luabind {
+
+// A pool of lua states that are set up once, and reused. Every state
+// is opened with luabind::open() and passed to the initializer, which
+// typically registers the application's bindings. When a state is
+// released the tables reachable from its global table are restored to
+// what they were after the initializer returned, so it can be handed
+// out again without being set up again.
+//
+// The restored tables are the ones reachable through the keys, values
+// and metatables of tables, starting from the global table and the
+// string metatable. That includes the libraries, package.loaded and the
+// namespaces. It doesn't include:
+//
+//  - the registry, and the tables only reachable from it
+//  - the members of classes, which are kept by the class objects
+//  - namespaces that still have registrations left to do, see
+//    compiled_module::register_lazily()
+//  - the environments of functions and the values of upvalues
+//  - the metatables of types other than tables and strings
+//
+// Changes made to those persist, so the pool doesn't isolate the
+// scripts from each other unless they leave them alone.
+//
+// The pool may be used from any number of threads.
+class LUABIND_API state_pool : boost::noncopyable
+{
+public:
+    typedef boost::function1<void, lua_State*> initializer;
+
+    // creates size states up front
+    explicit state_pool(initializer const& init, std::size_t size = 0);
+
+    // closes the idle states. the states that are still acquired are
+    // left to the user to close.
+    ~state_pool();
+
+    // returns an idle state, or a new one if there is none
+    lua_State* acquire();
+
+    // restores the tables of a state acquired from this pool, and makes
+    // it available again
+    void release(lua_State* L);
+
+    // creates states until there are at least n idle states
+    void reserve(std::size_t n);
+
+    // the number of idle states
+    std::size_t size() const;
+
+private:
+    lua_State* create() const;
+
+    initializer m_init;
+
+    class impl;
+    boost::scoped_ptr<impl> m_impl;
+};
+
+// acquires a state from a pool for the duration of a scope
+class scoped_state : boost::noncopyable
+{
+public:
+    explicit scoped_state(state_pool& pool)
+      : m_pool(pool)
+      , m_state(pool.acquire())
+    {}
+
+    ~scoped_state()
+    {
+        m_pool.release(m_state);
+    }
+
+    operator lua_State*() const
+    {
+        return m_state;
+    }
+
+private:
+    state_pool& m_pool;
+    lua_State* m_state;
+};
+
+} // namespace luabind
+
+#endif // LUABIND_STATE_POOL_HPP_INCLUDED
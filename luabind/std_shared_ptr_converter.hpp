@@ -48,4 +48,10 @@ namespace tr1 {
 
 #endif // if BOOST_VERSION < 105300
 
+namespace luabind { namespace detail {
+  // the instances pushed from std::shared_ptr can be cached as well
+  template<class T>
+  struct is_shared_pointer<std::shared_ptr<T>>: boost::mpl::true_ { };
+}}
+
 #endif
@@ -29,15 +29,33 @@
 
 namespace luabind {
 
+    // A weak reference to a Lua value. The values are kept in a single
+    // weak table per state, each weak_ref owns one slot in it.
     class LUABIND_API weak_ref
     {
     public:
         weak_ref();
         weak_ref(lua_State* main, lua_State* L, int index);
         weak_ref(weak_ref const&);
+#ifndef BOOST_NO_CXX11_RVALUE_REFERENCES
+        weak_ref(weak_ref&& other) BOOST_NOEXCEPT
+          : m_state(other.m_state)
+          , m_table(other.m_table)
+          , m_ref(other.m_ref)
+        {
+            other.m_state = 0;
+        }
+#endif
         ~weak_ref();
 
         weak_ref& operator=(weak_ref const&);
+#ifndef BOOST_NO_CXX11_RVALUE_REFERENCES
+        weak_ref& operator=(weak_ref&& other) BOOST_NOEXCEPT
+        {
+            swap(other);
+            return *this;
+        }
+#endif
 
         void swap(weak_ref&);
 
@@ -49,8 +67,11 @@ namespace luabind {
         void get(lua_State* L) const;
 
     private:
-        struct impl;
-        impl* m_impl;
+        lua_State* m_state;
+        // registry reference to the weak table
+        int m_table;
+        // the slot in the weak table
+        int m_ref;
     };
 
 } // namespace luabind
@@ -32,6 +32,8 @@
 
 #include <cstring>
 #include <iostream>
+#include <stdexcept>
+#include <string>
 
 namespace luabind
 {
@@ -64,12 +66,16 @@ namespace luabind { namespace detail {
 
         void register_(lua_State* L) const;
 
+        char const* lazy_name() const;
+        void lazy_class_ids(std::vector<class_id>& ids) const;
+
         const char* m_name;
 
-        mutable std::map<const char*, int, detail::ltstr> m_static_constants;
+        // shared with the class_reps registered from this
+        boost::shared_ptr<class_rep::constant_map> m_static_constants;
 
         typedef std::pair<type_id, cast_function> base_desc;
-        mutable std::vector<base_desc> m_bases;
+        std::vector<base_desc> m_bases;
 
         type_id m_type;
         class_id m_id;
@@ -80,9 +86,14 @@ namespace luabind { namespace detail {
         scope m_scope;
         scope m_members;
         scope m_default_members;
+
+        bool m_identity_cache;
+        std::size_t m_embedded_size;
     };
 
     class_registration::class_registration(char const* name)
+      : m_identity_cache(false)
+      , m_embedded_size(0)
     {
         m_name = name;
     }
@@ -93,11 +104,43 @@ namespace luabind { namespace detail {
 
         assert(lua_type(L, -1) == LUA_TTABLE);
 
+        detail::class_registry* r = detail::class_registry::get_registry(L);
+
+        lua_pushstring(L, "__luabind_class_map");
+        lua_rawget(L, LUA_REGISTRYINDEX);
+        class_map& classes = *static_cast<class_map*>(
+            lua_touserdata(L, -1));
+        lua_pop(L, 1);
+
+        // the base classes are looked up first, so nothing is
+        // registered if one of them is missing. a lazily registered
+        // base can't be found if its name has been assigned to.
+        std::vector<detail::class_rep*> bases;
+
+        for (std::vector<base_desc>::const_iterator i = m_bases.begin();
+            i != m_bases.end(); ++i)
+        {
+            detail::class_rep* bcrep = r->find_class(i->first);
+
+            if (!bcrep && classes.has_lazy_classes())
+                bcrep = materialize_class(L, allocate_class_id(i->first));
+
+            if (!bcrep)
+            {
+# ifndef LUABIND_NO_EXCEPTIONS
+                throw std::runtime_error(std::string("a base class of '")
+                    + m_name + "' is not registered, or can't be found");
+# else
+                assert(false && "a base class is not registered");
+# endif
+            }
+
+            bases.push_back(bcrep);
+        }
+
         lua_pushstring(L, m_name);
 
         detail::class_rep* crep;
-
-        detail::class_registry* r = detail::class_registry::get_registry(L);
         // create a class_rep structure for this class.
         // allocate it within lua to let lua collect it on
         // lua_close(). This is better than allocating it
@@ -117,12 +160,6 @@ namespace luabind { namespace detail {
         // register this new type in the class registry
         r->add_class(m_type, crep);
 
-        lua_pushstring(L, "__luabind_class_map");
-        lua_rawget(L, LUA_REGISTRYINDEX);
-        class_map& classes = *static_cast<class_map*>(
-            lua_touserdata(L, -1));
-        lua_pop(L, 1);
-
         classes.put(m_id, crep);
 
         bool const has_wrapper = m_wrapper_id != registered_class<null_type>::id;
@@ -130,9 +167,12 @@ namespace luabind { namespace detail {
         if (has_wrapper)
             classes.put(m_wrapper_id, crep);
 
-        crep->m_static_constants.swap(m_static_constants);
+        crep->m_static_constants = m_static_constants;
 
-		detail::class_registry* registry = detail::class_registry::get_registry(L);
+        if (m_identity_cache)
+            crep->enable_identity_cache(L);
+
+        crep->m_embedded_size = m_embedded_size;
 
         crep->get_default_table(L);
         m_scope.register_(L);
@@ -165,13 +205,13 @@ namespace luabind { namespace detail {
             casts->insert(e.src, e.target, e.cast);
         }
 
-        for (std::vector<base_desc>::iterator i = m_bases.begin();
-            i != m_bases.end(); ++i)
+        for (std::vector<detail::class_rep*>::const_iterator i = bases.begin();
+            i != bases.end(); ++i)
         {
             LUABIND_CHECK_STACK(L);
 
             // the baseclass' class_rep structure
-            detail::class_rep* bcrep = registry->find_class(i->first);
+            detail::class_rep* bcrep = *i;
 
             detail::class_rep::base_info base;
             base.pointer_offset = 0;
@@ -229,8 +269,34 @@ namespace luabind { namespace detail {
 
 		}
 
+        crep->get_table(L);
+        lua_pushliteral(L, "__finalize");
+        lua_rawget(L, -2);
+        crep->m_has_finalizer = !lua_isnil(L, -1);
+        lua_pop(L, 2);
+
+        crep->update_operators(L);
+        crep->update_instance_index(L);
+
         lua_settable(L, -3);
     }
+
+    char const* class_registration::lazy_name() const
+    {
+        return m_name;
+    }
+
+    void class_registration::lazy_class_ids(std::vector<class_id>& ids) const
+    {
+        ids.push_back(m_id);
+
+        if (m_wrapper_id != registered_class<null_type>::id)
+            ids.push_back(m_wrapper_id);
+
+        // the nested classes are registered with this one
+        for (registration const* r = m_scope.chain(); r; r = r->next())
+            r->lazy_class_ids(ids);
+    }
     
     // -- interface ---------------------------------------------------------
 
@@ -275,7 +341,13 @@ namespace luabind { namespace detail {
 
     void class_base::add_static_constant(const char* name, int val)
     {
-        m_registration->m_static_constants[name] = val;
+        boost::shared_ptr<class_rep::constant_map>& constants =
+            m_registration->m_static_constants;
+
+        if (!constants)
+            constants.reset(new class_rep::constant_map);
+
+        (*constants)[name] = val;
     }
 
     void class_base::add_inner_scope(scope& s)
@@ -289,6 +361,16 @@ namespace luabind { namespace detail {
         m_registration->m_casts.push_back(cast_entry(src, target, cast));
     }
 
+    void class_base::enable_identity_cache()
+    {
+        m_registration->m_identity_cache = true;
+    }
+
+    void class_base::enable_embedding(std::size_t size)
+    {
+        m_registration->m_embedded_size = size;
+    }
+
 	void add_custom_name(type_id const& i, std::string& s)
 	{
 		s += " [";
@@ -69,6 +69,7 @@ namespace luabind
 				crep = obj->crep();
 			}
 		}
+		crep->flatten_members(L);
 		crep->get_table(L);
         object table(from_stack(L, -1));
         lua_pop(L, 1);
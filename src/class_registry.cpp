@@ -30,6 +30,7 @@
 #include <luabind/detail/class_rep.hpp>  // for class_rep
 #include <luabind/detail/garbage_collector.hpp>  // for garbage_collector
 
+#include <boost/atomic.hpp>             // for atomic
 
 #include <cassert>                      // for assert
 #include <map>                          // for map, etc
@@ -37,7 +38,7 @@
 
 namespace luabind { namespace detail {
 
-    LUABIND_API void push_instance_metatable(lua_State* L);
+    LUABIND_API void push_instance_metatable(lua_State* L, bool dynamic);
 
     namespace {
 
@@ -78,6 +79,30 @@ namespace luabind { namespace detail {
             return create_cpp_class_metatable(L);
         }
 
+#ifdef LUABIND_NOT_THREADSAFE
+
+// the cache is kept per thread where the compiler supports it, so
+// every thread running its own lua state gets hits. otherwise it's
+// shared, and only one thread may use luabind.
+# if defined(_MSC_VER)
+#  define LUABIND_THREAD_LOCAL __declspec(thread)
+# elif defined(__GNUC__)
+#  define LUABIND_THREAD_LOCAL __thread
+# else
+#  define LUABIND_THREAD_LOCAL
+# endif
+
+        LUABIND_THREAD_LOCAL lua_State* cache_key = 0;
+        LUABIND_THREAD_LOCAL class_registry* registry_cache = 0;
+
+        // incremented whenever a registry is destroyed. a new state may
+        // be allocated at the address of a closed one, on any thread,
+        // so the cache is only valid in the generation it was filled in.
+        LUABIND_THREAD_LOCAL long cache_generation = 0;
+        boost::atomic<long> registry_generation(0);
+
+#endif
+
     } // namespace unnamed
 
     class class_rep;
@@ -86,8 +111,22 @@ namespace luabind { namespace detail {
         : m_cpp_class_metatable(create_cpp_class_metatable(L))
         , m_lua_class_metatable(create_lua_class_metatable(L))
     {
-        push_instance_metatable(L);
+        push_instance_metatable(L, false);
         m_instance_metatable = luaL_ref(L, LUA_REGISTRYINDEX);
+
+        push_instance_metatable(L, true);
+        m_dynamic_instance_metatable = luaL_ref(L, LUA_REGISTRYINDEX);
+    }
+
+    class_registry::~class_registry()
+    {
+#ifdef LUABIND_NOT_THREADSAFE
+
+        // another state may be allocated at the same address, this
+        // invalidates the cache of every thread
+        ++registry_generation;
+
+#endif
     }
 
     class_registry* class_registry::get_registry(lua_State* L)
@@ -98,9 +137,10 @@ namespace luabind { namespace detail {
         // if we don't have to be thread safe, we can keep a
         // chache of the class_registry pointer without the
         // need of a mutex
-        static lua_State* cache_key = 0;
-        static class_registry* registry_cache = 0;
-        if (cache_key == L) return registry_cache;
+        long const generation =
+            registry_generation.load(boost::memory_order_acquire);
+        if (cache_key == L && cache_generation == generation)
+            return registry_cache;
 
 #endif
 
@@ -113,6 +153,7 @@ namespace luabind { namespace detail {
 
         cache_key = L;
         registry_cache = p;
+        cache_generation = generation;
 
 #endif
 
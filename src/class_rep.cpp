@@ -29,6 +29,9 @@
 #include <luabind/luabind.hpp>
 #include <luabind/exception_handler.hpp>
 #include <luabind/get_main_thread.hpp>
+#include <boost/atomic.hpp>
+#include <algorithm>
+#include <cstring>
 #include <utility>
 
 #if LUA_VERSION_NUM < 502
@@ -54,11 +57,34 @@ luabind::detail::class_rep::class_rep(type_id const& type
 	: m_type(type)
 	, m_name(name)
 	, m_class_type(cpp_class)
-	, m_operator_cache(0)
+	, m_has_finalizer(false)
+	, m_init_function(0)
+	, m_embedded_size(0)
+	, m_generation(0)
+	, m_member_generation(0)
 {
 	shared_init(L);
 }
 
+namespace
+{
+	// returns a registry reference to a shallow copy of the table
+	// referenced by ref
+	int copy_table_ref(lua_State* L, int ref)
+	{
+		lua_newtable(L);
+		lua_rawgeti(L, LUA_REGISTRYINDEX, ref);
+		lua_pushnil(L);
+		while (lua_next(L, -2))
+		{
+			lua_pushvalue(L, -2);
+			lua_insert(L, -2);
+			lua_rawset(L, -5);
+		}
+		lua_pop(L, 1);
+		return luaL_ref(L, LUA_REGISTRYINDEX);
+	}
+}
 
 void luabind::detail::class_rep::shared_init(lua_State * L) {
 	lua_newtable(L);
@@ -77,7 +103,14 @@ void luabind::detail::class_rep::shared_init(lua_State * L) {
 	lua_pushvalue(L, -1); // duplicate our user data
 	m_self_ref.set(L);
 
-	m_instance_metatable = (m_class_type == cpp_class) ? r->cpp_instance() : r->lua_instance();
+	// every class has its own instance metatables, copies of the ones
+	// in the registry. the operators the class defines are installed
+	// in the first one by update_operators(), the dynamic one looks
+	// them up through the instance.
+	int const instance_metatable =
+		(m_class_type == cpp_class) ? r->cpp_instance() : r->lua_instance();
+	m_instance_metatable = copy_table_ref(L, instance_metatable);
+	m_dynamic_instance_metatable = copy_table_ref(L, r->dynamic_instance());
 
     lua_pushstring(L, "__luabind_cast_graph");
     lua_gettable(L, LUA_REGISTRYINDEX);
@@ -95,13 +128,50 @@ luabind::detail::class_rep::class_rep(lua_State* L, const char* name)
 	: m_type(typeid(null_type))
 	, m_name(name)
 	, m_class_type(lua_class)
-	, m_operator_cache(0)
+	, m_has_finalizer(false)
+	, m_init_function(0)
+	, m_embedded_size(0)
+	, m_generation(0)
+	, m_member_generation(0)
 {
 	shared_init(L);
 }
 
 luabind::detail::class_rep::~class_rep()
 {
+	// the bases of a lua class must not invalidate it once it's gone.
+	// only lua classes are registered with their bases.
+	for (std::vector<base_info>::const_iterator i = m_bases.begin();
+		m_class_type == lua_class && i != m_bases.end(); ++i)
+	{
+		std::vector<class_rep*>& derived = i->base->m_derived;
+		derived.erase(
+			std::remove(derived.begin(), derived.end(), this), derived.end());
+	}
+
+	// the derived classes keep their bases alive, so they can only be
+	// left behind when the state is closed. they must not unregister
+	// from this class then.
+	for (std::vector<class_rep*>::const_iterator i = m_derived.begin();
+		i != m_derived.end(); ++i)
+	{
+		std::vector<base_info>& bases = (*i)->m_bases;
+
+		for (std::vector<base_info>::iterator j = bases.begin();
+			j != bases.end();)
+		{
+			if (j->base == this)
+				j = bases.erase(j);
+			else
+				++j;
+		}
+	}
+
+	if (lua_State* L = m_table.interpreter())
+	{
+		luaL_unref(L, LUA_REGISTRYINDEX, m_instance_metatable);
+		luaL_unref(L, LUA_REGISTRYINDEX, m_dynamic_instance_metatable);
+	}
 }
 
 // leaves object on lua stack
@@ -116,7 +186,14 @@ luabind::detail::class_rep::allocate(lua_State* L) const
 namespace
 {
 
-  bool super_deprecation_disabled = false;
+  // disable_super_deprecation() may be called while other threads are
+  // constructing instances
+  boost::atomic<bool> super_deprecation_disabled(false);
+
+  bool is_super_deprecation_disabled()
+  {
+      return super_deprecation_disabled.load(boost::memory_order_relaxed);
+  }
 
 } // namespace unnamed
 
@@ -127,11 +204,14 @@ int luabind::detail::class_rep::constructor_dispatcher(lua_State* L)
 
     int args = lua_gettop(L);
 
-    push_new_instance(L, cls);
+    push_new_instance(L, cls, cls->embedded_size());
+
+    // super is only set for lua classes with a base class to construct
+    bool const set_super = cls->get_class_type() == class_rep::lua_class
+        && !cls->bases().empty()
+        && is_super_deprecation_disabled();
 
-    if (super_deprecation_disabled
-        && cls->get_class_type() == class_rep::lua_class
-        && !cls->bases().empty())
+    if (set_super)
     {
         lua_pushvalue(L, 1);
         lua_pushvalue(L, -2);
@@ -139,21 +219,31 @@ int luabind::detail::class_rep::constructor_dispatcher(lua_State* L)
         lua_setglobal(L, "super");
     }
 
-    lua_pushvalue(L, -1);
+    // the instance replaces the class as the first argument
     lua_replace(L, 1);
 
-    cls->get_table(L);
-    lua_pushliteral(L, "__init");
-    lua_gettable(L, -2);
-
-    lua_insert(L, 1);
-
-    lua_pop(L, 1);
-    lua_insert(L, 1);
+    if (!cls->m_init.interpreter())
+    {
+        cls->push_init(L);
+        lua_pop(L, 1);
+    }
 
-    lua_call(L, args, 0);
+    if (cls->m_init_function)
+    {
+        // c++ constructors are called directly
+        call_function_object(L, *cls->m_init_function);
+        lua_settop(L, 1);
+    }
+    else
+    {
+        lua_pushvalue(L, 1);
+        lua_insert(L, 1);
+        cls->m_init.push(L);
+        lua_insert(L, 2);
+        lua_call(L, args, 0);
+    }
 
-    if (super_deprecation_disabled)
+    if (set_super)
     {
         lua_pushnil(L);
         lua_setglobal(L, "super");
@@ -162,6 +252,31 @@ int luabind::detail::class_rep::constructor_dispatcher(lua_State* L)
     return 1;
 }
 
+void luabind::detail::class_rep::push_init(lua_State* L)
+{
+	if (!m_init.interpreter())
+	{
+		get_table(L);
+		lua_pushliteral(L, "__init");
+		lua_gettable(L, -2);
+		lua_remove(L, -2);
+
+		handle(L, -1).swap(m_init);
+
+		if (is_luabind_function(L, -1))
+		{
+			lua_getupvalue(L, -1, 1);
+			m_init_function =
+				*static_cast<function_object const**>(lua_touserdata(L, -1));
+			lua_pop(L, 1);
+		}
+
+		return;
+	}
+
+	m_init.push(L);
+}
+
 void luabind::detail::class_rep::add_base_class(const luabind::detail::class_rep::base_info& binfo)
 {
 	// If you hit this assert you are deriving from a type that is not registered
@@ -173,21 +288,25 @@ void luabind::detail::class_rep::add_base_class(const luabind::detail::class_rep
 
 	class_rep* bcrep = binfo.base;
 
-	// import all static constants
-	for (std::map<const char*, int, ltstr>::const_iterator i = bcrep->m_static_constants.begin(); 
-			i != bcrep->m_static_constants.end(); ++i)
-	{
-		int& v = m_static_constants[i->first];
-		v = i->second;
-	}
-
 	// also, save the baseclass info to be used for typecasts
 	m_bases.push_back(binfo);
+
+	// lua classes look up inherited members on demand, so they
+	// need to know when the base class is modified
+	if (m_class_type == lua_class)
+	{
+		bcrep->m_derived.push_back(this);
+
+		// the base class constructor is called on instances of this
+		// class
+		if (bcrep->m_embedded_size > m_embedded_size)
+			m_embedded_size = bcrep->m_embedded_size;
+	}
 }
 
 LUABIND_API void luabind::disable_super_deprecation()
 {
-    super_deprecation_disabled = true;
+    super_deprecation_disabled.store(true, boost::memory_order_relaxed);
 }
 
 int luabind::detail::class_rep::super_callback(lua_State* L)
@@ -210,11 +329,8 @@ int luabind::detail::class_rep::super_callback(lua_State* L)
 		lua_setglobal(L, "super");
 	}
 
-	base->get_table(L);
-	lua_pushstring(L, "__init");
-	lua_gettable(L, -2);
+	base->push_init(L);
 	lua_insert(L, 1);
-	lua_pop(L, 1);
 
 	lua_pushvalue(L, lua_upvalueindex(2));
 	lua_insert(L, 2);
@@ -232,13 +348,54 @@ int luabind::detail::class_rep::super_callback(lua_State* L)
 
 
 
+namespace
+{
+	// true if the member keeps the member table from being used as
+	// __index by the instances, see update_instance_index()
+	bool is_indirect_member(lua_State* L, int key_index, int value_index)
+	{
+		return lua_tocfunction(L, value_index) == &property_tag
+			|| (lua_type(L, key_index) == LUA_TSTRING
+				&& std::strcmp(lua_tostring(L, key_index), "__index") == 0);
+	}
+}
+
 int luabind::detail::class_rep::lua_settable_dispatcher(lua_State* L)
 {
 	class_rep* crep = static_cast<class_rep*>(lua_touserdata(L, 1));
 
+	int op = -1;
+	if (lua_type(L, 2) == LUA_TSTRING)
+	{
+		char const* key = lua_tostring(L, 2);
+		for (int i = 0; i < number_of_operators && op == -1; ++i)
+		{
+			if (std::strcmp(key, get_operator_name(i)) == 0) op = i;
+		}
+
+		if (std::strcmp(key, "__finalize") == 0)
+			crep->m_has_finalizer = !lua_isnil(L, 3);
+	}
+
+	// the cached inherited members has to be dropped before the
+	// new member is added, it may be shadowing one of them
+	crep->invalidate_members();
+
+	handle().swap(crep->m_init);
+	crep->m_init_function = 0;
+	crep->validate_members(L);
+
 	// get first table
 	crep->get_table(L);
 
+	// the instance metatable only has to be updated if the new member,
+	// or the one it replaces, decides how the instances are indexed
+	lua_pushvalue(L, 2);
+	lua_rawget(L, -2);
+	bool const update_index =
+		is_indirect_member(L, 2, 3) || is_indirect_member(L, 2, -1);
+	lua_pop(L, 1);
+
 	// copy key, value
 	lua_pushvalue(L, -3);
 	lua_pushvalue(L, -3);
@@ -251,11 +408,38 @@ int luabind::detail::class_rep::lua_settable_dispatcher(lua_State* L)
 	lua_replace(L, 1);
 	lua_rawset(L, -3);
 
-	crep->m_operator_cache = 0; // invalidate cache
-	
+	if (op != -1) crep->update_operator(L, op);
+	if (update_index) crep->update_instance_index(L);
+
 	return 0;
 }
 
+bool luabind::detail::class_rep::find_static_constant(
+	char const* name, int& value) const
+{
+	if (m_static_constants)
+	{
+		constant_map::const_iterator i = m_static_constants->find(name);
+
+		if (i != m_static_constants->end())
+		{
+			value = i->second;
+			return true;
+		}
+	}
+
+	// the constants of the base classes are looked up instead of
+	// being copied, so they can be shared
+	for (std::vector<base_info>::const_iterator i = m_bases.begin();
+		i != m_bases.end(); ++i)
+	{
+		if (i->base->find_static_constant(name, value))
+			return true;
+	}
+
+	return false;
+}
+
 /*
 	stack:
 	1: class_rep
@@ -266,11 +450,9 @@ int luabind::detail::class_rep::static_class_gettable(lua_State* L)
 	class_rep* crep = static_cast<class_rep*>(lua_touserdata(L, 1));
 
 	// look in the static function table
-	crep->get_default_table(L);
-	lua_pushvalue(L, 2);
-	lua_gettable(L, -2);
+	crep->get_member(L, 2, true);
 	if (!lua_isnil(L, -1)) return 1;
-	else lua_pop(L, 2);
+	else lua_pop(L, 1);
 
 	const char* key = lua_tostring(L, 2);
 
@@ -280,11 +462,11 @@ int luabind::detail::class_rep::static_class_gettable(lua_State* L)
 		return 1;
 	}
 
-	std::map<const char*, int, ltstr>::const_iterator j = crep->m_static_constants.find(key);
+	int value;
 
-	if (j != crep->m_static_constants.end())
+	if (crep->find_static_constant(key, value))
 	{
-		lua_pushnumber(L, j->second);
+		lua_pushnumber(L, value);
 		return 1;
 	}
 
@@ -343,28 +525,285 @@ void luabind::detail::finalize(lua_State* L, class_rep* crep)
 	}
 }
 
-void luabind::detail::class_rep::cache_operators(lua_State* L)
+namespace
+{
+	// lua passes the unary operators a second operand, the bound
+	// functions only take the first one
+	int dispatch_unary_operator(lua_State* L)
+	{
+		lua_settop(L, 1);
+		lua_pushvalue(L, lua_upvalueindex(1));
+		lua_insert(L, 1);
+		lua_call(L, 1, 1);
+		return 1;
+	}
+}
+
+void luabind::detail::class_rep::update_operators(lua_State* L)
+{
+	for (int op = 0; op < number_of_operators; ++op)
+		update_operator(L, op);
+}
+
+void luabind::detail::class_rep::update_operator(lua_State* L, int op)
+{
+	// lua only calls the comparison metamethods if both operands have
+	// the same one, they are dispatched by the closures shared by all
+	// instance metatables instead
+	if (op == op_lt || op == op_le || op == op_eq)
+		return;
+
+	// the dynamic metatable dispatches every operator through the
+	// instance, it's left as it is
+	lua_rawgeti(L, LUA_REGISTRYINDEX, m_instance_metatable);
+	lua_pushstring(L, get_operator_name(op));
+	lua_pushvalue(L, -1);
+	get_member(L, lua_gettop(L));
+	lua_remove(L, -2);
+
+	if (!lua_isnil(L, -1) && (op == op_unm || op == op_len))
+		lua_pushcclosure(L, &dispatch_unary_operator, 1);
+
+	lua_rawset(L, -3);
+	lua_pop(L, 1);
+
+	for (std::vector<class_rep*>::const_iterator i = m_derived.begin();
+		i != m_derived.end(); ++i)
+	{
+		(*i)->update_operator(L, op);
+	}
+}
+
+void luabind::detail::class_rep::update_instance_index(lua_State* L)
 {
-	m_operator_cache = 0x1;
+	// the member table can only be used as __index if no lookup
+	// needs the instance itself, or falls through to the base classes
+	bool direct = !has_lazy_members();
+
+	if (direct)
+	{
+		get_table(L);
+		lua_pushnil(L);
+		while (lua_next(L, -2))
+		{
+			if (is_indirect_member(L, -2, -1))
+			{
+				direct = false;
+				lua_pop(L, 2);
+				break;
+			}
+
+			lua_pop(L, 1);
+		}
+		lua_pop(L, 1);
+	}
+
+	lua_rawgeti(L, LUA_REGISTRYINDEX, m_instance_metatable);
+	lua_pushliteral(L, "__index");
 
-	for (int i = 0; i < number_of_operators; ++i)
+	if (direct)
 	{
 		get_table(L);
-		lua_pushstring(L, get_operator_name(i));
+	}
+	else
+	{
+		lua_rawgeti(L, LUA_REGISTRYINDEX, m_dynamic_instance_metatable);
+		lua_pushliteral(L, "__index");
 		lua_rawget(L, -2);
+		lua_remove(L, -2);
+	}
 
-		if (lua_isfunction(L, -1)) m_operator_cache |= 1 << (i + 1);
+	lua_rawset(L, -3);
+	lua_pop(L, 1);
+}
 
-		lua_pop(L, 2);
+namespace
+{
+	// __init and __finalize are never inherited from the base class
+	bool is_inheritable_member(lua_State* L, int key_index)
+	{
+		if (lua_type(L, key_index) != LUA_TSTRING)
+			return true;
+
+		char const* key = lua_tostring(L, key_index);
+		return std::strcmp(key, "__init") != 0
+			&& std::strcmp(key, "__finalize") != 0;
+	}
+}
+
+void luabind::detail::class_rep::get_member(
+	lua_State* L, int key_index, bool default_table)
+{
+	validate_members(L);
+
+	handle const& table = default_table ? m_default_table : m_table;
+
+	table.push(L);
+	lua_pushvalue(L, key_index);
+	lua_rawget(L, -2);
+
+	if (!lua_isnil(L, -1)
+		|| !has_lazy_members()
+		|| !is_inheritable_member(L, key_index))
+	{
+		lua_remove(L, -2);
+		return;
+	}
+
+	lua_pop(L, 1);
+
+	for (std::vector<base_info>::const_iterator i = m_bases.begin();
+		i != m_bases.end(); ++i)
+	{
+		i->base->get_member(L, key_index, default_table);
+
+		if (lua_isnil(L, -1))
+		{
+			lua_pop(L, 1);
+			continue;
+		}
+
+		// cache the inherited member in our own table, and remember
+		// that it's inherited so it can be dropped if the base changes
+		lua_pushvalue(L, key_index);
+		lua_pushvalue(L, -2);
+		lua_rawset(L, -4);
+
+		if (!m_inherited.interpreter())
+		{
+			lua_newtable(L);
+			handle(L, -1).swap(m_inherited);
+			lua_pop(L, 1);
+		}
+
+		m_inherited.push(L);
+		lua_pushvalue(L, key_index);
+		lua_pushboolean(L, 1);
+		lua_rawset(L, -3);
+		lua_pop(L, 1);
+
+		lua_remove(L, -2);
+		return;
+	}
+
+	lua_pop(L, 1);
+	lua_pushnil(L);
+}
+
+void luabind::detail::class_rep::flatten_members(lua_State* L)
+{
+	if (!has_lazy_members())
+		return;
+
+	for (std::vector<base_info>::const_iterator i = m_bases.begin();
+		i != m_bases.end(); ++i)
+	{
+		i->base->flatten_members(L);
+
+		for (int which = 0; which < 2; ++which)
+		{
+			if (which == 0) i->base->get_table(L);
+			else i->base->get_default_table(L);
+
+			lua_pushnil(L);
+			while (lua_next(L, -2))
+			{
+				lua_pop(L, 1);
+				get_member(L, lua_gettop(L), which == 1);
+				lua_pop(L, 1);
+			}
+
+			lua_pop(L, 1);
+		}
+	}
+}
+
+void luabind::detail::class_rep::invalidate_members()
+{
+	++m_generation;
+
+	for (std::vector<class_rep*>::const_iterator i = m_derived.begin();
+		i != m_derived.end(); ++i)
+	{
+		(*i)->invalidate_members();
+	}
+}
+
+void luabind::detail::class_rep::flush_members(lua_State* L)
+{
+	m_member_generation = m_generation;
+
+	if (!m_inherited.interpreter())
+		return;
+
+	m_inherited.push(L);
+	get_table(L);
+	get_default_table(L);
+
+	lua_pushnil(L);
+	while (lua_next(L, -4))
+	{
+		lua_pop(L, 1);
+
+		lua_pushvalue(L, -1);
+		lua_pushnil(L);
+		lua_rawset(L, -4);
+
+		lua_pushvalue(L, -1);
+		lua_pushnil(L);
+		lua_rawset(L, -5);
 	}
+
+	lua_pop(L, 3);
+
+	handle().swap(m_inherited);
 }
 
-bool luabind::detail::class_rep::has_operator_in_lua(lua_State* L, int id)
+namespace
 {
-	if ((m_operator_cache & 0x1) == 0)
-		cache_operators(L);
 
-	const int mask = 1 << (id + 1);
+  void push_identity_cache(lua_State* L)
+  {
+      lua_newtable(L);
+      lua_createtable(L, 0, 1);
+      lua_pushliteral(L, "__mode");
+      lua_pushliteral(L, "v");
+      lua_rawset(L, -3);
+      lua_setmetatable(L, -2);
+  }
+
+} // namespace unnamed
+
+void luabind::detail::class_rep::enable_identity_cache(lua_State* L)
+{
+	push_identity_cache(L);
+	handle(L, -1).swap(m_identity_cache);
+	push_identity_cache(L);
+	handle(L, -1).swap(m_const_identity_cache);
+	lua_pop(L, 2);
+}
 
-	return (m_operator_cache & mask) != 0;
+bool luabind::detail::class_rep::push_cached_instance(
+	lua_State* L, void const* p, bool pointee_const)
+{
+	(pointee_const ? m_const_identity_cache : m_identity_cache).push(L);
+	lua_pushlightuserdata(L, const_cast<void*>(p));
+	lua_rawget(L, -2);
+	lua_remove(L, -2);
+
+	if (get_instance(L, -1))
+		return true;
+
+	lua_pop(L, 1);
+	return false;
+}
+
+void luabind::detail::class_rep::cache_instance(
+	lua_State* L, void const* p, bool pointee_const)
+{
+	(pointee_const ? m_const_identity_cache : m_identity_cache).push(L);
+	lua_pushlightuserdata(L, const_cast<void*>(p));
+	lua_pushvalue(L, -3);
+	lua_rawset(L, -3);
+	lua_pop(L, 1);
 }
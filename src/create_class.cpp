@@ -27,48 +27,12 @@
 #include <luabind/luabind.hpp>
 
 #if LUA_VERSION_NUM < 502
-# define lua_compare(L, index1, index2, fn) fn(L, index1, index2)
-# define LUA_OPEQ lua_equal
 # define lua_rawlen lua_objlen
+# define lua_setuservalue lua_setfenv
 #endif
 
 namespace luabind { namespace detail
 {
-	namespace
-	{
-		// expects two tables on the lua stack:
-		// 1: destination
-		// 2: source
-		void copy_member_table(lua_State* L)
-		{
-			lua_pushnil(L);
-
-			while (lua_next(L, -2))
-			{
-				lua_pushstring(L, "__init");
-				if (lua_compare(L, -1, -3, LUA_OPEQ))
-				{
-					lua_pop(L, 2);
-					continue;
-				}
-				else lua_pop(L, 1); // __init string
-
-				lua_pushstring(L, "__finalize");
-				if (lua_compare(L, -1, -3, LUA_OPEQ))
-				{
-					lua_pop(L, 2);
-					continue;
-				}
-				else lua_pop(L, 1); // __finalize string
-
-				lua_pushvalue(L, -2); // copy key
-				lua_insert(L, -2);
-				lua_settable(L, -5);
-			}
-		}
-	}
-
-
 	int create_class::stage2(lua_State* L)
 	{
 		class_rep* crep = static_cast<class_rep*>(lua_touserdata(L, lua_upvalueindex(1)));
@@ -90,17 +54,19 @@ namespace luabind { namespace detail
 
 		binfo.pointer_offset = 0;
 		binfo.base = base;
+		// the base class members are not copied, they are looked up
+		// through the base class the first time they are accessed
 		crep->add_base_class(binfo);
 
-		// copy base class members
-
-		crep->get_table(L);
-		base->get_table(L);
-		copy_member_table(L);
+		// the base class is only referenced through its class_rep, so
+		// it's kept alive by the environment of the derived class
+		lua_createtable(L, 1, 0);
+		lua_pushvalue(L, 1);
+		lua_rawseti(L, -2, 1);
+		lua_setuservalue(L, lua_upvalueindex(1));
 
-		crep->get_default_table(L);
-		base->get_default_table(L);
-		copy_member_table(L);
+		crep->update_operators(L);
+		crep->update_instance_index(L);
 
 		crep->set_type(base->type());
 
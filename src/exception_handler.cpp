@@ -11,9 +11,20 @@
 #ifndef LUABIND_NO_EXCEPTIONS
 #include <luabind/error.hpp>            // for error
 #include <luabind/exception_handler.hpp>  // for exception_handler_base
+#include <luabind/detail/mutex.hpp>     // for mutex
 
 #include <exception>                    // for exception
+#include <map>                          // for map
 #include <stdexcept>                    // for logic_error, runtime_error
+#include <typeinfo>                     // for type_info
+#include <vector>                       // for vector
+
+// the type of the exception being handled can be queried from the
+// C++ ABI on these runtimes, otherwise the handler chain is used.
+#if defined(__GLIBCXX__) || defined(_LIBCPP_VERSION)
+# include <cxxabi.h>
+# define LUABIND_CURRENT_EXCEPTION_TYPE() abi::__cxa_current_exception_type()
+#endif
 
 namespace luabind { namespace detail {
 
@@ -21,6 +32,89 @@ namespace
 {
   exception_handler_base* handler_chain = 0;
 
+  // guards the handler chain and the handler cache, so handlers can
+  // be registered, and exceptions translated, from any thread. it's
+  // statically initialized, so it can be used by static constructors.
+  // it's only held to read or update them, never while a handler runs.
+  mutex handler_lock;
+
+#ifdef LUABIND_CURRENT_EXCEPTION_TYPE
+  struct type_info_less
+  {
+      bool operator()(std::type_info const* x, std::type_info const* y) const
+      {
+          return x->before(*y) != 0;
+      }
+  };
+
+  typedef std::map<
+      std::type_info const*, exception_handler_base const*, type_info_less
+  > handler_map;
+
+  // maps the types of the exceptions thrown so far to the handler
+  // in the chain that handles them, or to null if none does.
+  // cleared when a handler is registered.
+  handler_map& handler_cache()
+  {
+      static handler_map cache;
+      return cache;
+  }
+
+  exception_handler_base const* find_handler()
+  {
+      std::type_info const* type = LUABIND_CURRENT_EXCEPTION_TYPE();
+
+      // can_handle() rethrows the exception, so the handlers are
+      // tested on a copy of the chain, without holding the lock
+      std::vector<exception_handler_base const*> chain;
+
+      {
+          mutex::scoped_lock lock(handler_lock);
+
+          if (!handler_chain)
+              return 0;
+
+          handler_map& cache = handler_cache();
+          handler_map::iterator i = cache.find(type);
+
+          if (i != cache.end())
+              return i->second;
+
+          for (exception_handler_base const* p = handler_chain; p; p = p->next)
+              chain.push_back(p);
+      }
+
+      // the handlers registered last take precedence, just like
+      // when the exception is passed through the chain
+      exception_handler_base const* result = 0;
+
+      for (std::vector<exception_handler_base const*>::reverse_iterator i =
+          chain.rbegin(); i != chain.rend(); ++i)
+      {
+          if ((*i)->can_handle())
+          {
+              result = *i;
+              break;
+          }
+      }
+
+      mutex::scoped_lock lock(handler_lock);
+
+      // a handler registered meanwhile cleared the cache, and may take
+      // precedence over the result
+      if (chain.back()->next == 0)
+          handler_cache().insert(handler_map::value_type(type, result));
+
+      return result;
+  }
+#else
+  exception_handler_base const* chain_head()
+  {
+      mutex::scoped_lock lock(handler_lock);
+      return handler_chain;
+  }
+#endif
+
   void push_exception_string(lua_State* L, char const* exception, char const* what)
   {
       lua_pushstring(L, exception);
@@ -33,8 +127,16 @@ namespace
 
 void exception_handler_base::try_next(lua_State* L) const
 {
-    if (next)
-        next->handle(L);
+    exception_handler_base const* p;
+
+    {
+        // the next handler may be appended by another thread
+        mutex::scoped_lock lock(handler_lock);
+        p = next;
+    }
+
+    if (p)
+        p->handle(L);
     else
         throw;
 }
@@ -43,8 +145,13 @@ LUABIND_API void handle_exception_aux(lua_State* L)
 {
     try
     {
-        if (handler_chain)
-            handler_chain->handle(L);
+#ifdef LUABIND_CURRENT_EXCEPTION_TYPE
+        if (exception_handler_base const* handler = find_handler())
+            handler->handle_current(L);
+#else
+        if (exception_handler_base const* head = chain_head())
+            head->handle(L);
+#endif
         else
             throw;
     }
@@ -74,6 +181,8 @@ LUABIND_API void handle_exception_aux(lua_State* L)
 
 LUABIND_API void register_exception_handler(exception_handler_base* handler)
 {
+    mutex::scoped_lock lock(handler_lock);
+
     if (!handler_chain) handler_chain = handler;
     else
     {
@@ -84,6 +193,10 @@ LUABIND_API void register_exception_handler(exception_handler_base* handler)
         handler->next = 0;
         p->next = handler;
     }
+
+#ifdef LUABIND_CURRENT_EXCEPTION_TYPE
+    handler_cache().clear();
+#endif
 }
 
 }} // namespace luabind::detail
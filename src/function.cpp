@@ -5,6 +5,10 @@
 #define LUABIND_BUILDING
 
 #include <luabind/make_function.hpp>
+#include <luabind/detail/object_rep.hpp>
+#include <luabind/detail/class_rep.hpp>
+
+#include <cassert>
 
 namespace luabind { namespace detail {
 
@@ -43,6 +47,16 @@ namespace
   // by luabind.
   int function_tag = 0;
 
+# ifndef LUABIND_NO_EXCEPTIONS
+  // entry point for overload sets where the function registered last
+  // doesn't throw, but some of the others may
+  int protected_entry_point(lua_State* L)
+  {
+      return call_function_object(L,
+          **(function_object const**)lua_touserdata(L, lua_upvalueindex(1)));
+  }
+# endif
+
 } // namespace unnamed
 
 LUABIND_API bool is_luabind_function(lua_State* L, int index)
@@ -65,6 +79,37 @@ namespace
       return result;
   }
 
+  // an overload with the same signature as f could never be called,
+  // every call would be ambiguous. registering one is an error, in
+  // release builds it's replaced by f.
+  void remove_hidden_overload(function_object* f)
+  {
+      type_id const signature = f->signature_id();
+
+      for (function_object* prev = f; prev->next; prev = prev->next)
+      {
+          function_object* p = prev->next;
+
+          if (p->signature_id() == signature)
+          {
+              assert(false && "you are trying to register an overload "
+                  "with the same signature as an existing one");
+
+              prev->next = p->next;
+              prev->keepalive = p->keepalive;
+
+              // the overload may still be cached by the functions
+              // before it
+              for (function_object* q = f; q != prev->next; q = q->next)
+              {
+                  q->cache.clear();
+                  q->error_message = object();
+              }
+              return;
+          }
+      }
+  }
+
 } // namespace unnamed
 
 LUABIND_API void add_overload(
@@ -79,6 +124,27 @@ LUABIND_API void add_overload(
         {
             f->next = *touserdata<function_object*>(getupvalue(overloads, 1));
             f->keepalive = overloads;
+
+            remove_hidden_overload(f);
+
+# ifndef LUABIND_NO_EXCEPTIONS
+            // all the overloads are called through the entry point of
+            // f, it can only skip the exception handling if none of them
+            // throws
+            if (f->no_throw && f->next && !f->next->no_throw)
+            {
+                f->no_throw = false;
+
+                lua_State* L = fn.interpreter();
+                fn.push(L);
+                lua_getupvalue(L, -1, 1);
+                lua_getupvalue(L, -2, 2);
+                lua_pushcclosure(L, &protected_entry_point, 2);
+                context[name] = object(from_stack(L, -1));
+                lua_pop(L, 2);
+                return;
+            }
+# endif
         }
     }
 
@@ -99,14 +165,203 @@ LUABIND_API object make_function_aux(lua_State* L, function_object* impl)
     return object(from_stack(L, -1));
 }
 
+namespace
+{
+
+  int const max_cached_arguments = LUABIND_MAX_ARITY + 1;
+
+  // fills in the types of the arguments on the stack. returns false if
+  // the overload resolution can depend on more than their types, in
+  // which case the result can't be cached.
+  bool get_argument_types(
+      lua_State* L, overload_cache::argument_type* arguments, int n)
+  {
+      if (n > max_cached_arguments)
+          return false;
+
+      for (int i = 0; i < n; ++i)
+      {
+          arguments[i].type = lua_type(L, i + 1);
+          arguments[i].cls = 0;
+
+          // converters can match tables and foreign userdata on their
+          // contents
+          if (arguments[i].type == LUA_TTABLE)
+              return false;
+
+          if (arguments[i].type == LUA_TUSERDATA)
+          {
+              object_rep* instance = get_instance(L, i + 1);
+
+              if (!instance)
+                  return false;
+
+              arguments[i].cls = instance->crep();
+
+              // LUA_TNONE is never the type of an argument, it's
+              // used for const instances
+              if (instance->is_const())
+                  arguments[i].type = LUA_TNONE;
+          }
+      }
+
+      return true;
+  }
+
+  bool same_argument_types(
+      std::vector<overload_cache::argument_type> const& x
+    , overload_cache::argument_type const* y, int n)
+  {
+      if (static_cast<int>(x.size()) != n)
+          return false;
+
+      for (int i = 0; i < n; ++i)
+      {
+          if (x[i].type != y[i].type || x[i].cls != y[i].cls)
+              return false;
+      }
+
+      return true;
+  }
+
+} // namespace unnamed
+
+function_object const* overload_cache::find(
+    argument_type const* arguments, int n) const
+{
+    for (int i = 0; i < size; ++i)
+    {
+        if (entries[i].match
+            && same_argument_types(entries[i].arguments, arguments, n))
+        {
+            return entries[i].match;
+        }
+    }
+
+    return 0;
+}
+
+void overload_cache::insert(
+    argument_type const* arguments, int n, function_object const* match)
+{
+    entry& e = entries[next_entry];
+    e.arguments.assign(arguments, arguments + n);
+    e.match = match;
+    next_entry = (next_entry + 1) % size;
+}
+
+void overload_cache::clear()
+{
+    for (int i = 0; i < size; ++i)
+        entries[i].match = 0;
+}
+
+LUABIND_API int call_overloads(
+    lua_State* L, function_object const& overloads, invoke_context& ctx)
+{
+# ifndef LUABIND_NO_OVERLOAD_CACHE
+    overload_cache::argument_type arguments[max_cached_arguments];
+    int const n = lua_gettop(L);
+    bool const cacheable = get_argument_types(L, arguments, n);
+
+    if (cacheable)
+    {
+        if (function_object const* match = overloads.cache.find(arguments, n))
+        {
+            ctx.single_overload = true;
+            int results = match->call(L, ctx);
+
+            if (ctx)
+                return results;
+
+            // the cached overload doesn't match after all, resolve
+            // the call from scratch
+            ctx = invoke_context();
+        }
+    }
+
+    int results = overloads.call(L, ctx);
+
+    if (cacheable && ctx)
+        overloads.cache.insert(arguments, n, ctx.match);
+
+    return results;
+# else
+    return overloads.call(L, ctx);
+# endif
+}
+
+LUABIND_API int call_function_object(
+    lua_State* L, function_object const& fn)
+{
+    invoke_context ctx;
+
+    int results = 0;
+
+# ifndef LUABIND_NO_EXCEPTIONS
+    bool exception_caught = false;
+
+    try
+    {
+        results = fn.next ? call_overloads(L, fn, ctx) : fn.call(L, ctx);
+    }
+    catch (...)
+    {
+        exception_caught = true;
+        handle_exception_aux(L);
+    }
+
+    if (exception_caught)
+        lua_error(L);
+# else
+    results = fn.next ? call_overloads(L, fn, ctx) : fn.call(L, ctx);
+# endif
+
+    if (!ctx)
+    {
+        ctx.format_error(L, &fn);
+        lua_error(L);
+    }
+
+    return results;
+}
+
+void invoke_context::format_ambiguity(lua_State* L) const
+{
+    char const* function_name = candidates->function->name.empty() ?
+        "<unknown>" : candidates->function->name.c_str();
+
+    int stacksize = lua_gettop(L);
+    lua_pushstring(L, "Ambiguous, candidates:\n");
+    for (invoke_candidate const* c = candidates; c != 0; c = c->next)
+    {
+        if (c != candidates)
+            lua_pushstring(L, "\n");
+        c->function->format_signature(L, function_name);
+    }
+    lua_concat(L, lua_gettop(L) - stacksize);
+}
+
 void invoke_context::format_error(
     lua_State* L, function_object const* overloads) const
 {
     char const* function_name =
         overloads->name.empty() ? "<unknown>" : overloads->name.c_str();
 
-    if (candidate_index == 0)
+    if (candidate_count == 0)
     {
+        // the message only changes when classes are registered, since
+        // it names them. it's reused until then.
+        std::size_t classes =
+            class_registry::get_registry(L)->get_classes().size();
+
+        if (overloads->error_message.is_valid()
+            && overloads->error_classes == classes)
+        {
+            overloads->error_message.push(L);
+            return;
+        }
+
         int stacksize = lua_gettop(L);
         lua_pushstring(L, "No matching overload found, candidates:\n");
         int count = 0;
@@ -118,19 +373,9 @@ void invoke_context::format_error(
             ++count;
         }
         lua_concat(L, lua_gettop(L) - stacksize);
-    }
-    else
-    {
-        // Ambiguous
-        int stacksize = lua_gettop(L);
-        lua_pushstring(L, "Ambiguous, candidates:\n");
-        for (int i = 0; i < candidate_index; ++i)
-        {
-            if (i != 0)
-                lua_pushstring(L, "\n");
-            candidates[i]->format_signature(L, function_name);
-        }
-        lua_concat(L, lua_gettop(L) - stacksize);
+
+        overloads->error_message = object(from_stack(L, -1));
+        overloads->error_classes = classes;
     }
 }
 
@@ -4,16 +4,21 @@
 
 #define LUABIND_BUILDING
 
+#include <algorithm>
+#include <iterator>
 #include <limits>
 #include <map>
+#include <memory>
 #include <vector>
 #include <queue>
+#include <boost/atomic.hpp>
 #include <boost/dynamic_bitset.hpp>
 #include <boost/foreach.hpp>
 #include <boost/tuple/tuple.hpp>
 #include <boost/tuple/tuple_comparison.hpp>
 #include <luabind/typeid.hpp>
 #include <luabind/detail/inheritance.hpp>
+#include <luabind/detail/mutex.hpp>
 
 namespace luabind { namespace detail {
 
@@ -51,16 +56,33 @@ namespace
 
   typedef std::pair<std::ptrdiff_t, int> cache_entry;
 
+  // the cache is read without locking. the entries are looked up in an
+  // immutable snapshot, sorted by key. the entries added since it was
+  // made are kept in a map, that is only used with the graph locked, and
+  // merged into a new snapshot once it has grown to half the size of
+  // the current one. the replaced snapshots may still be read, so they
+  // are retired, and deleted the next time the cache is updated while
+  // no thread is reading it. the readers are counted for this, a reader
+  // that starts after a snapshot has been replaced can't read it.
   class cache
   {
   public:
       static std::ptrdiff_t const unknown;
       static std::ptrdiff_t const invalid;
 
+      cache();
+      ~cache();
+
+      // may be called without the lock
       cache_entry get(
           class_id src, class_id target, class_id dynamic_id
         , std::ptrdiff_t object_offset) const;
 
+      // these must be called with the lock held
+      cache_entry get_locked(
+          class_id src, class_id target, class_id dynamic_id
+        , std::ptrdiff_t object_offset) const;
+
       void put(
           class_id src, class_id target, class_id dynamic_id
         , std::ptrdiff_t object_offset
@@ -72,35 +94,141 @@ namespace
       typedef boost::tuple<
           class_id, class_id, class_id, std::ptrdiff_t> key_type;
       typedef std::map<key_type, cache_entry> map_type;
-      map_type m_cache;
+      typedef std::vector<std::pair<key_type, cache_entry> > snapshot;
+
+      struct key_less
+      {
+          bool operator()(
+              snapshot::value_type const& x, key_type const& y) const
+          {
+              return x.first < y;
+          }
+
+          template <class X, class Y>
+          bool operator()(X const& x, Y const& y) const
+          {
+              return x.first < y.first;
+          }
+      };
+
+      void publish(snapshot* next);
+      void reclaim();
+
+      boost::atomic<snapshot const*> m_snapshot;
+      mutable boost::atomic<unsigned int> m_readers;
+      std::vector<snapshot const*> m_retired;
+      map_type m_pending;
   };
 
   std::ptrdiff_t const cache::unknown =
       std::numeric_limits<std::ptrdiff_t>::max();
   std::ptrdiff_t const cache::invalid = cache::unknown - 1;
 
+  cache::cache()
+    : m_snapshot(new snapshot)
+    , m_readers(0)
+  {}
+
+  cache::~cache()
+  {
+      delete m_snapshot.load(boost::memory_order_relaxed);
+
+      BOOST_FOREACH(snapshot const* retired, m_retired)
+      {
+          delete retired;
+      }
+  }
+
   cache_entry cache::get(
       class_id src, class_id target, class_id dynamic_id
     , std::ptrdiff_t object_offset) const
   {
-      map_type::const_iterator i = m_cache.find(
+      // the counter and the snapshot are accessed sequentially
+      // consistent, so a snapshot is either replaced after the reader
+      // has been counted, or before it's read
+      ++m_readers;
+
+      snapshot const& entries = *m_snapshot.load();
+      key_type const key(src, target, dynamic_id, object_offset);
+
+      snapshot::const_iterator i = std::lower_bound(
+          entries.begin(), entries.end(), key, key_less());
+
+      cache_entry const result = i != entries.end() && i->first == key
+          ? i->second : cache_entry(unknown, -1);
+
+      --m_readers;
+
+      return result;
+  }
+
+  cache_entry cache::get_locked(
+      class_id src, class_id target, class_id dynamic_id
+    , std::ptrdiff_t object_offset) const
+  {
+      map_type::const_iterator i = m_pending.find(
           key_type(src, target, dynamic_id, object_offset));
-      return i != m_cache.end() ? i->second : cache_entry(unknown, -1);
+
+      if (i != m_pending.end())
+          return i->second;
+
+      // the snapshot may have been replaced since it was read
+      return get(src, target, dynamic_id, object_offset);
   }
 
   void cache::put(
       class_id src, class_id target, class_id dynamic_id
     , std::ptrdiff_t object_offset, std::ptrdiff_t offset, int distance)
   {
-      m_cache.insert(std::make_pair(
+      reclaim();
+
+      m_pending.insert(std::make_pair(
           key_type(src, target, dynamic_id, object_offset)
         , cache_entry(offset, distance)
       ));
+
+      snapshot const& current = *m_snapshot.load(boost::memory_order_relaxed);
+
+      if (m_pending.size() < current.size() / 2 + 8)
+          return;
+
+      std::auto_ptr<snapshot> next(new snapshot);
+      next->reserve(current.size() + m_pending.size());
+
+      std::merge(
+          current.begin(), current.end()
+        , m_pending.begin(), m_pending.end()
+        , std::back_inserter(*next)
+        , key_less()
+      );
+
+      m_pending.clear();
+      publish(next.release());
   }
 
   void cache::invalidate()
   {
-      m_cache.clear();
+      m_pending.clear();
+      publish(new snapshot);
+  }
+
+  void cache::publish(snapshot* next)
+  {
+      m_retired.push_back(m_snapshot.exchange(next));
+      reclaim();
+  }
+
+  void cache::reclaim()
+  {
+      if (m_retired.empty() || m_readers.load() != 0)
+          return;
+
+      BOOST_FOREACH(snapshot const* retired, m_retired)
+      {
+          delete retired;
+      }
+
+      m_retired.clear();
   }
 
 } // namespace unnamed
@@ -114,6 +242,14 @@ public:
     void insert(class_id src, class_id target, cast_function cast);
 
 private:
+    // finds the cast in the graph, and caches it. called with the
+    // graph locked.
+    std::pair<void*, int> search(
+        void* p, class_id src, class_id target
+      , class_id dynamic_id, std::ptrdiff_t object_offset) const;
+
+    // the graph is shared by every state, see shared_cast_graph()
+    mutable mutex m_mutex;
     std::vector<vertex> m_vertices;
     mutable cache m_cache;
 };
@@ -143,21 +279,35 @@ std::pair<void*, int> cast_graph::impl::cast(
     if (src == target)
         return std::make_pair(p, 0);
 
-    if (src >= m_vertices.size() || target >= m_vertices.size())
-        return std::pair<void*, int>((void*)0, -1);
-
     std::ptrdiff_t const object_offset =
         (char const*)dynamic_ptr - (char const*)p;
 
+    // the cached casts are found without locking
     cache_entry cached = m_cache.get(src, target, dynamic_id, object_offset);
 
-    if (cached.first != cache::unknown)
+    if (cached.first == cache::unknown)
     {
-        if (cached.first == cache::invalid)
+        mutex::scoped_lock lock(m_mutex);
+
+        if (src >= m_vertices.size() || target >= m_vertices.size())
             return std::pair<void*, int>((void*)0, -1);
-        return std::make_pair((char*)p + cached.first, cached.second);
+
+        cached = m_cache.get_locked(src, target, dynamic_id, object_offset);
+
+        if (cached.first == cache::unknown)
+            return search(p, src, target, dynamic_id, object_offset);
     }
 
+    if (cached.first == cache::invalid)
+        return std::pair<void*, int>((void*)0, -1);
+
+    return std::make_pair((char*)p + cached.first, cached.second);
+}
+
+std::pair<void*, int> cast_graph::impl::search(
+    void* const p, class_id src, class_id target
+  , class_id dynamic_id, std::ptrdiff_t object_offset) const
+{
     std::queue<queue_entry> q;
     q.push(queue_entry(p, src, 0));
 
@@ -198,6 +348,8 @@ std::pair<void*, int> cast_graph::impl::cast(
 void cast_graph::impl::insert(
     class_id src, class_id target, cast_function cast)
 {
+    mutex::scoped_lock lock(m_mutex);
+
     class_id const max_id = std::max(src, target);
 
     if (max_id >= m_vertices.size())
@@ -239,10 +391,47 @@ cast_graph::cast_graph()
 cast_graph::~cast_graph()
 {}
 
+namespace
+{
+  // class ids are allocated by the static initializers of
+  // registered_class<>, possibly while other threads are running. the
+  // lock is statically initialized so it's usable from those, and the
+  // map is constructed on first use, while it's held. it also guards
+  // the allocation of the local class ids.
+  mutex class_id_lock;
+} // namespace unnamed
+
+class_id class_id_map::allocate_local_id(type_id const& type)
+{
+    typedef std::map<type_id, class_id> map_type;
+
+    mutex::scoped_lock lock(class_id_lock);
+
+    static map_type allocated;
+    static class_id id = local_id_base;
+
+    std::pair<map_type::iterator, bool> inserted = allocated.insert(
+        std::make_pair(type, id));
+
+    if (inserted.second)
+        ++id;
+
+    return inserted.first->second;
+}
+
+cast_graph& shared_cast_graph()
+{
+    mutex::scoped_lock lock(class_id_lock);
+    static cast_graph graph;
+    return graph;
+}
+
 LUABIND_API class_id allocate_class_id(type_id const& cls)
 {
     typedef std::map<type_id, class_id> map_type;
 
+    mutex::scoped_lock lock(class_id_lock);
+
     static map_type registered;
     static class_id id = 0;
 
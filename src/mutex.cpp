@@ -0,0 +1,34 @@
+// Copyright Daniel Wallin 2009. Use, modification and distribution is
+// subject to the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#define LUABIND_BUILDING
+
+#include <luabind/detail/mutex.hpp>
+
+#if defined(_WIN32)
+# ifndef WIN32_LEAN_AND_MEAN
+#  define WIN32_LEAN_AND_MEAN
+# endif
+# include <windows.h>
+#else
+# include <sched.h>
+#endif
+
+namespace luabind { namespace detail {
+
+void mutex::wait(unsigned int spins)
+{
+    // the lock is usually held for a few instructions, so it's likely
+    // to be released before the time slice is given up
+    if (spins < 16)
+        return;
+
+#if defined(_WIN32)
+    Sleep(0);
+#else
+    sched_yield();
+#endif
+}
+
+}} // namespace luabind::detail
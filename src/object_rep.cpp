@@ -34,66 +34,128 @@ namespace luabind { namespace detail
 {
 
 	// dest is a function that is called to delete the c++ object this struct holds
-	object_rep::object_rep(instance_holder* instance, class_rep* crep)
+	object_rep::object_rep(
+		instance_holder* instance, class_rep* crep, std::size_t embedded_size)
 		: m_instance(instance)
 		, m_classrep(crep)
 		, m_dependency_cnt(0)
+		, m_dependency_ref(LUA_NOREF)
+		, m_embedded_size(embedded_size)
 	{}
 
 	object_rep::~object_rep()
 	{
+        reset();
+	}
+
+	void object_rep::reset()
+	{
         if (!m_instance)
             return;
         m_instance->~instance_holder();
         deallocate(m_instance);
+        m_instance = 0;
 	}
 
 	void object_rep::add_dependency(lua_State* L, int index)
 	{
-        assert(m_dependency_cnt < sizeof(object_rep));
-
-        void* key = (char*)this + m_dependency_cnt;
+        // there's nothing to keep alive, and luaL_ref() would return
+        // LUA_REFNIL which is not a slot of its own
+        if (lua_isnil(L, index))
+            return;
 
-        lua_pushlightuserdata(L, key);
-        lua_pushvalue(L, index);
-        lua_rawset(L, LUA_REGISTRYINDEX);
+        if (m_dependency_cnt == 0)
+        {
+            lua_pushvalue(L, index);
+            m_dependency_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+        }
+        else
+        {
+            if (m_dependency_cnt == 1)
+            {
+                // move the single dependency into a table, stored
+                // under the same reference
+                lua_createtable(L, 2, 0);
+                lua_rawgeti(L, LUA_REGISTRYINDEX, m_dependency_ref);
+                lua_rawseti(L, -2, 1);
+                lua_pushvalue(L, -1);
+                lua_rawseti(L, LUA_REGISTRYINDEX, m_dependency_ref);
+            }
+            else
+            {
+                lua_rawgeti(L, LUA_REGISTRYINDEX, m_dependency_ref);
+            }
+
+            lua_pushvalue(L, index);
+            lua_rawseti(L, -2, static_cast<int>(m_dependency_cnt) + 1);
+            lua_pop(L, 1);
+        }
 
         ++m_dependency_cnt;
 	}
 
     void object_rep::release_dependency_refs(lua_State* L)
     {
-        for (std::size_t i = 0; i < m_dependency_cnt; ++i)
+        if (m_dependency_cnt == 0)
+            return;
+
+        luaL_unref(L, LUA_REGISTRYINDEX, m_dependency_ref);
+        m_dependency_cnt = 0;
+    }
+
+    bool object_rep::has_lua_state(lua_State* L, int index) const
+    {
+        if (m_classrep->get_class_type() == class_rep::lua_class
+            || m_dependency_cnt != 0)
         {
-            void* key = (char*)this + i;
-            lua_pushlightuserdata(L, key);
-            lua_pushnil(L);
-            lua_rawset(L, LUA_REGISTRYINDEX);
+            return true;
         }
+
+        // instances with members of their own have a table with the
+        // class' table as metatable
+        lua_getuservalue(L, index);
+        bool result = lua_getmetatable(L, -1) != 0;
+        lua_pop(L, result ? 2 : 1);
+        return result;
     }
 
     int destroy_instance(lua_State* L)
     {
         object_rep* instance = static_cast<object_rep*>(lua_touserdata(L, 1));
 
-        lua_pushstring(L, "__finalize");
-        lua_gettable(L, 1);
+        // only classes with a __finalize member, or instances with
+        // members of their own, can have a finalizer
+        bool finalizer = instance->crep()->has_finalizer();
 
-        if (lua_isnil(L, -1))
+        if (!finalizer)
         {
-            lua_pop(L, 1);
+            lua_getuservalue(L, 1);
+            finalizer = lua_getmetatable(L, -1) != 0;
+            lua_settop(L, 1);
         }
-        else
+
+        if (finalizer)
         {
-            lua_pushvalue(L, 1);
-            lua_call(L, 1, 0);
+            lua_pushstring(L, "__finalize");
+            lua_gettable(L, 1);
+
+            if (lua_isnil(L, -1))
+            {
+                lua_pop(L, 1);
+            }
+            else
+            {
+                lua_pushvalue(L, 1);
+                lua_call(L, 1, 0);
+            }
         }
 
         instance->release_dependency_refs(L);
-        instance->~object_rep();
 
-        lua_pushnil(L);
-        lua_setmetatable(L, 1);
+        // the object_rep is left empty instead of being destroyed, so
+        // there's no need to reset the metatable. if the instance is
+        // resurrected it just won't convert to anything.
+        instance->reset();
         return 0;
     }
 
@@ -102,6 +164,10 @@ namespace luabind { namespace detail
 
       int set_instance_value(lua_State* L)
       {
+          class_rep* crep = static_cast<object_rep*>(
+              lua_touserdata(L, 1))->crep();
+          crep->validate_members(L);
+
           lua_getuservalue(L, 1);
           lua_pushvalue(L, 2);
           lua_rawget(L, -2);
@@ -114,6 +180,12 @@ namespace luabind { namespace detail
               lua_pop(L, 1);
           }
 
+          if (lua_isnil(L, -1) && crep->has_lazy_members())
+          {
+              lua_pop(L, 1);
+              crep->get_member(L, 2);
+          }
+
           if (lua_tocfunction(L, -1) == &property_tag)
           {
               // this member is a property, extract the "set" function and call it.
@@ -132,16 +204,9 @@ namespace luabind { namespace detail
           }
           else if (lua_isnil(L, -1))
           {
-              // If a metatable exists we need to use that
-              if (!lua_getmetatable(L, -2))
-              {
-                  // No metatable, push user value to the right position
-                  lua_pushvalue(L, -2);
-              }
-
               // Value not known, check the __newindex function
               lua_pushstring(L, "__newindex");
-              lua_rawget(L, -2);
+              crep->get_member(L, lua_gettop(L));
 
               if (!lua_isnil(L, -1))
               {
@@ -155,7 +220,7 @@ namespace luabind { namespace detail
               {
                   lua_pop(L, 1);
               }
-              // Pop the table again
+              // Pop the key again
               lua_pop(L, 1);
           }
 
@@ -168,6 +233,11 @@ namespace luabind { namespace detail
               lua_setuservalue(L, 1);
               lua_pushvalue(L, 4);
               lua_setmetatable(L, -2);
+
+              // the class' member table can no longer be used as
+              // __index for this instance
+              lua_rawgeti(L, LUA_REGISTRYINDEX, crep->dynamic_metatable_ref());
+              lua_setmetatable(L, 1);
           }
           else
           {
@@ -183,6 +253,10 @@ namespace luabind { namespace detail
 
       int get_instance_value(lua_State* L)
       {
+          class_rep* crep = static_cast<object_rep*>(
+              lua_touserdata(L, 1))->crep();
+          crep->validate_members(L);
+
           lua_getuservalue(L, 1);
           lua_pushvalue(L, 2);
           lua_rawget(L, -2);
@@ -193,6 +267,12 @@ namespace luabind { namespace detail
               lua_rawget(L, -2);
           }
 
+          if (lua_isnil(L, -1) && crep->has_lazy_members())
+          {
+              lua_pop(L, 1);
+              crep->get_member(L, 2);
+          }
+
           if (lua_tocfunction(L, -1) == &property_tag)
           {
               // this member is a property, extract the "get" function and call it.
@@ -213,7 +293,8 @@ namespace luabind { namespace detail
 
               // Value not known, check the __index function
               lua_pushstring(L, "__index");
-              lua_rawget(L, -3);
+              crep->get_member(L, lua_gettop(L));
+              lua_remove(L, -2);
 
               if (!lua_isnil(L, -1))
               {
@@ -250,10 +331,12 @@ namespace luabind { namespace detail
 
                   lua_insert(L, 1); // move the function to the bottom
 
-                  nargs = lua_toboolean(L, lua_upvalueindex(2)) ? 1 : nargs;
-
-                  if (lua_toboolean(L, lua_upvalueindex(2))) // remove trailing nil
-                  lua_remove(L, 3);
+                  // lua passes the unary operators a second operand
+                  if (lua_toboolean(L, lua_upvalueindex(2)))
+                  {
+                      lua_settop(L, 2);
+                      nargs = 1;
+                  }
 
                   lua_call(L, nargs, 1);
                   return 1;
@@ -269,7 +352,7 @@ namespace luabind { namespace detail
 
     } // namespace unnamed
 
-    LUABIND_API void push_instance_metatable(lua_State* L)
+    LUABIND_API void push_instance_metatable(lua_State* L, bool dynamic)
     {
         lua_newtable(L);
 
@@ -288,8 +371,18 @@ namespace luabind { namespace detail
         lua_pushcclosure(L, set_instance_value, 0);
         lua_setfield(L, -2, "__newindex");
 
+        // The other operators are installed directly in the metatable
+        // of the classes defining them. Lua only calls the comparison
+        // metamethods if both operands have the same one, so they are
+        // dispatched from here for every class. The dynamic metatable
+        // is used by the instances with a table of their own, it
+        // dispatches every operator, so the ones assigned to the
+        // instance are found too.
         for (int op = 0; op < number_of_operators; ++op)
         {
+            if (!dynamic && op != op_lt && op != op_le && op != op_eq)
+                continue;
+
             lua_pushstring(L, get_operator_name(op));
             lua_pushvalue(L, -1);
             lua_pushboolean(L, op == op_unm || op == op_len);
@@ -315,10 +408,11 @@ namespace luabind { namespace detail
         return result;
     }
 
-    LUABIND_API object_rep* push_new_instance(lua_State* L, class_rep* cls)
+    LUABIND_API object_rep* push_new_instance(
+        lua_State* L, class_rep* cls, std::size_t embedded_size)
     {
-        void* storage = lua_newuserdata(L, sizeof(object_rep));
-        object_rep* result = new (storage) object_rep(0, cls);
+        void* storage = lua_newuserdata(L, sizeof(object_rep) + embedded_size);
+        object_rep* result = new (storage) object_rep(0, cls, embedded_size);
         cls->get_table(L);
         lua_setuservalue(L, -2);
         lua_rawgeti(L, LUA_REGISTRYINDEX, cls->metatable_ref());
@@ -126,8 +126,14 @@ namespace
         }
 
         createGarbageCollectedRegistryUserdata<detail::class_registry>(L, "__luabind_classes", L);
+
         createGarbageCollectedRegistryUserdata<detail::class_id_map>(L, "__luabind_class_id_map");
-        createGarbageCollectedRegistryUserdata<detail::cast_graph>(L, "__luabind_cast_graph");
+
+        // the casts are the same for every state
+        lua_pushliteral(L, "__luabind_cast_graph");
+        lua_pushlightuserdata(L, &detail::shared_cast_graph());
+        lua_rawset(L, LUA_REGISTRYINDEX);
+
         createGarbageCollectedRegistryUserdata<detail::class_map>(L, "__luabind_class_map");
 
         // add functions (class, cast etc...)
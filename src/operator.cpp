@@ -24,9 +24,98 @@
 
 #include <luabind/operator.hpp>
 
+#include <new>
+#include <ostream>
+
 namespace luabind
 {
    LUABIND_API self_type self;
    LUABIND_API const_self_type const_self;
 }
 
+namespace luabind { namespace detail {
+
+void string_buffer::push(lua_State* L) const
+{
+    lua_pushlstring(L, m_string.data(), m_string.size());
+}
+
+string_buffer::int_type string_buffer::overflow(int_type c)
+{
+    if (!traits_type::eq_int_type(c, traits_type::eof()))
+        m_string += traits_type::to_char_type(c);
+    return traits_type::not_eof(c);
+}
+
+std::streamsize string_buffer::xsputn(char const* s, std::streamsize n)
+{
+    m_string.append(s, static_cast<std::size_t>(n));
+    return n;
+}
+
+namespace
+{
+
+  // the stream and buffer reused by the tostring operators of a state.
+  // the stream is only attached to the buffer while it's in use.
+  struct tostring_stream
+  {
+      tostring_stream()
+        : stream(0)
+      {}
+
+      string_buffer buffer;
+      std::ostream stream;
+  };
+
+  int destroy_tostring_stream(lua_State* L)
+  {
+      static_cast<tostring_stream*>(lua_touserdata(L, 1))->~tostring_stream();
+      return 0;
+  }
+
+} // namespace unnamed
+
+LUABIND_API std::ostream* acquire_tostring_stream(lua_State* L)
+{
+    lua_pushliteral(L, "luabind.tostring_stream");
+    lua_rawget(L, LUA_REGISTRYINDEX);
+
+    tostring_stream* state =
+        static_cast<tostring_stream*>(lua_touserdata(L, -1));
+    lua_pop(L, 1);
+
+    if (!state)
+    {
+        lua_pushliteral(L, "luabind.tostring_stream");
+        state = new (lua_newuserdata(L, sizeof(tostring_stream)))
+            tostring_stream;
+
+        lua_newtable(L);
+        lua_pushcclosure(L, &destroy_tostring_stream, 0);
+        lua_setfield(L, -2, "__gc");
+        lua_setmetatable(L, -2);
+
+        lua_rawset(L, LUA_REGISTRYINDEX);
+    }
+    else if (state->stream.rdbuf())
+    {
+        return 0;
+    }
+
+    std::ostream& stream = state->stream;
+
+    // undo any state or format change made by the previous call
+    stream.clear();
+    stream.flags(std::ios_base::dec | std::ios_base::skipws);
+    stream.precision(6);
+    stream.width(0);
+    stream.fill(' ');
+
+    state->buffer.clear();
+    stream.rdbuf(&state->buffer);
+    return &stream;
+}
+
+}} // namespace luabind::detail
+
@@ -26,11 +26,13 @@
 
 #include <luabind/scope.hpp>
 #include <luabind/detail/debug.hpp>
+#include <luabind/detail/inheritance.hpp>
 #include <luabind/detail/stack_utils.hpp>
 #include <cassert>
 
 #if LUA_VERSION_NUM < 502
 # define lua_pushglobaltable(L) lua_pushvalue(L, LUA_GLOBALSINDEX)
+# define lua_rawlen lua_objlen
 #endif
 
 namespace luabind { namespace detail {
@@ -45,6 +47,24 @@ namespace luabind { namespace detail {
         delete m_next;
     }
 
+    char const* registration::lazy_name() const
+    {
+        return 0;
+    }
+
+    scope const* registration::lazy_scope() const
+    {
+        return 0;
+    }
+
+    void registration::lazy_class_ids(std::vector<class_id>&) const
+    {
+    }
+
+#ifndef LUABIND_NO_EXCEPTIONS
+    LUABIND_API void handle_exception_aux(lua_State* L);
+#endif
+
     } // namespace detail
     
     scope::scope()
@@ -128,6 +148,390 @@ namespace luabind {
             lua_State* m_state;
         };
 
+        void push_module(lua_State* L, char const* name)
+        {
+            if (name)
+            {
+                lua_getglobal(L, name);
+
+                if (!lua_istable(L, -1))
+                {
+                    lua_pop(L, 1);
+
+                    lua_newtable(L);
+                    lua_pushvalue(L, -1);
+                    lua_setglobal(L, name);
+                }
+            }
+            else
+            {
+                lua_pushglobaltable(L);
+            }
+        }
+
+        void register_module(lua_State* L, char const* name, scope const& s)
+        {
+            push_module(L, name);
+
+            lua_pop_stack guard(L);
+
+            s.register_(L);
+        }
+
+        // -- lazy registration -------------------------------------------
+
+        // the registry table mapping the ids of the classes that are
+        // registered lazily to the path of names that has to be looked
+        // up to register them. the first element of a path is the
+        // module table.
+        char const* const lazy_classes = "luabind.lazy_classes";
+
+        detail::class_map& get_class_map(lua_State* L)
+        {
+            lua_pushliteral(L, "__luabind_class_map");
+            lua_rawget(L, LUA_REGISTRYINDEX);
+            detail::class_map* result =
+                static_cast<detail::class_map*>(lua_touserdata(L, -1));
+            lua_pop(L, 1);
+            return *result;
+        }
+
+        // pushes a copy of the path at the index path, with name
+        // appended to it
+        void push_child_path(lua_State* L, int path, char const* name)
+        {
+            int const n = static_cast<int>(lua_rawlen(L, path));
+
+            lua_createtable(L, n + 1, 0);
+
+            for (int i = 1; i <= n; ++i)
+            {
+                lua_rawgeti(L, path, i);
+                lua_rawseti(L, -2, i);
+            }
+
+            lua_pushstring(L, name);
+            lua_rawseti(L, -2, n + 1);
+        }
+
+        void register_lazily(lua_State* L, scope const& s, int path);
+
+        // registers r in the table on top of the stack, path is the
+        // (absolute) index of the table's path. the contents of
+        // namespaces are registered lazily.
+        void register_now(
+            lua_State* L, detail::registration const& r, int path)
+        {
+            scope const* contents = r.lazy_scope();
+
+            if (!contents)
+            {
+                r.register_(L);
+                return;
+            }
+
+            char const* name = r.lazy_name();
+
+            lua_pushstring(L, name);
+            lua_rawget(L, -2);
+
+            if (!lua_istable(L, -1))
+            {
+                lua_pop(L, 1);
+
+                lua_newtable(L);
+                lua_pushstring(L, name);
+                lua_pushvalue(L, -2);
+                lua_rawset(L, -4);
+            }
+
+            push_child_path(L, path, name);
+            lua_insert(L, -2);
+
+            register_lazily(L, *contents, lua_gettop(L) - 1);
+            lua_pop(L, 2);
+        }
+
+        // does the registrations left to do for the key on top of the
+        // stack, in the table at index table, and pops the key. pending
+        // is the index of the table mapping the names to the lists of
+        // registrations defining them, path is the index of the table's
+        // path. if a registration throws, the ones that weren't done are
+        // put back, so that the key is looked up again the next time.
+        void register_pending(lua_State* L, int table, int pending, int path)
+        {
+            int const key = lua_gettop(L);
+
+            lua_pushvalue(L, key);
+            lua_rawget(L, pending);
+
+            if (lua_isnil(L, -1))
+            {
+                lua_settop(L, key - 1);
+                return;
+            }
+
+            // the entry is removed while the registrations run, so that
+            // looking the name up from them doesn't run them again
+            lua_pushvalue(L, key);
+            lua_pushnil(L);
+            lua_rawset(L, pending);
+
+            int const list = lua_gettop(L);
+            int const n = static_cast<int>(lua_rawlen(L, list));
+
+            int i = 1;
+
+# ifndef LUABIND_NO_EXCEPTIONS
+            try
+            {
+# endif
+                for (; i <= n; ++i)
+                {
+                    lua_rawgeti(L, list, i);
+                    detail::registration const* r =
+                        static_cast<detail::registration const*>(
+                            lua_touserdata(L, -1));
+                    lua_pop(L, 1);
+
+                    lua_pushvalue(L, table);
+                    register_now(L, *r, path);
+                    lua_pop(L, 1);
+                }
+# ifndef LUABIND_NO_EXCEPTIONS
+            }
+            catch (...)
+            {
+                lua_settop(L, list);
+                lua_createtable(L, n - i + 1, 0);
+
+                for (int j = i; j <= n; ++j)
+                {
+                    lua_rawgeti(L, list, j);
+                    lua_rawseti(L, -2, j - i + 1);
+                }
+
+                lua_pushvalue(L, key);
+                lua_insert(L, -2);
+                lua_rawset(L, pending);
+
+                lua_settop(L, key - 1);
+                throw;
+            }
+# endif
+
+            lua_settop(L, key - 1);
+        }
+
+        // __index of the tables with registrations left to do. upvalue 1
+        // is the table mapping the names to the lists of registrations
+        // defining them, upvalue 2 is the path of the table.
+        int lazy_index(lua_State* L)
+        {
+            lua_pushvalue(L, lua_upvalueindex(1));
+            lua_pushvalue(L, lua_upvalueindex(2));
+            lua_pushvalue(L, 2);
+
+# ifndef LUABIND_NO_EXCEPTIONS
+            bool exception_caught = false;
+
+            try
+            {
+# endif
+                register_pending(L, 1, 3, 4);
+# ifndef LUABIND_NO_EXCEPTIONS
+            }
+            catch (...)
+            {
+                exception_caught = true;
+                lua_settop(L, 2);
+                detail::handle_exception_aux(L);
+            }
+
+            if (exception_caught)
+                lua_error(L);
+# endif
+
+            lua_settop(L, 2);
+            lua_rawget(L, 1);
+            return 1;
+        }
+
+        // replaces the key on top of the stack with its value in the
+        // table at index table. the registrations left to do for it are
+        // done first, by calling register_pending() rather than the
+        // table's __index, so no Lua code is run, and the registrations
+        // that fail throw instead of raising a Lua error.
+        void get_pending(lua_State* L, int table)
+        {
+            int const key = lua_gettop(L);
+
+            lua_pushvalue(L, key);
+            lua_rawget(L, table);
+
+            if (lua_isnil(L, -1) && lua_getmetatable(L, table))
+            {
+                lua_pushliteral(L, "__index");
+                lua_rawget(L, -2);
+
+                if (lua_tocfunction(L, -1) == &lazy_index)
+                {
+                    lua_getupvalue(L, -1, 1);
+                    lua_getupvalue(L, -2, 2);
+                    lua_pushvalue(L, key);
+                    register_pending(
+                        L, table, lua_gettop(L) - 2, lua_gettop(L) - 1);
+
+                    lua_pushvalue(L, key);
+                    lua_rawget(L, table);
+                    lua_replace(L, key + 1);
+                }
+
+                lua_settop(L, key + 1);
+            }
+
+            lua_replace(L, key);
+        }
+
+        // pushes the table of the registrations left to do in the table
+        // on top of the stack, and installs lazy_index() as its __index.
+        // returns false, and pushes nothing, if the table already has an
+        // __index of its own.
+        bool push_pending(lua_State* L, int path)
+        {
+            int const table = lua_gettop(L);
+
+            if (lua_getmetatable(L, table))
+            {
+                lua_pushliteral(L, "__index");
+                lua_rawget(L, -2);
+
+                if (lua_tocfunction(L, -1) == &lazy_index)
+                {
+                    lua_getupvalue(L, -1, 1);
+                    lua_replace(L, -3);
+                    lua_pop(L, 1);
+                    return true;
+                }
+
+                if (!lua_isnil(L, -1))
+                {
+                    lua_pop(L, 2);
+                    return false;
+                }
+
+                lua_pop(L, 1);
+            }
+            else
+            {
+                lua_newtable(L);
+                lua_pushvalue(L, -1);
+                lua_setmetatable(L, table);
+            }
+
+            lua_newtable(L);
+            lua_pushliteral(L, "__index");
+            lua_pushvalue(L, -2);
+            lua_pushvalue(L, path);
+            lua_pushcclosure(L, &lazy_index, 2);
+            lua_rawset(L, -4);
+            lua_replace(L, -2);
+            return true;
+        }
+
+        // registers the scope in the table on top of the stack. the
+        // registrations that define a name that isn't defined yet are
+        // left for lazy_index() to do, the others are done right away.
+        void register_lazily(lua_State* L, scope const& s, int path)
+        {
+            LUABIND_CHECK_STACK(L);
+
+            int const table = lua_gettop(L);
+
+            if (!push_pending(L, path))
+            {
+                for (detail::registration const* r = s.chain(); r; r = r->next())
+                    register_now(L, *r, path);
+                return;
+            }
+
+            int const pending = lua_gettop(L);
+
+            lua_getfield(L, LUA_REGISTRYINDEX, lazy_classes);
+
+            if (lua_isnil(L, -1))
+            {
+                lua_pop(L, 1);
+                lua_newtable(L);
+                lua_pushvalue(L, -1);
+                lua_setfield(L, LUA_REGISTRYINDEX, lazy_classes);
+            }
+
+            int const classes = lua_gettop(L);
+
+            std::vector<detail::class_id> ids;
+
+            for (detail::registration const* r = s.chain(); r; r = r->next())
+            {
+                char const* name = r->lazy_name();
+
+                bool defined = true;
+
+                if (name)
+                {
+                    lua_pushstring(L, name);
+                    lua_rawget(L, table);
+                    defined = !lua_isnil(L, -1);
+                    lua_pop(L, 1);
+                }
+
+                if (defined)
+                {
+                    lua_pushvalue(L, table);
+                    register_now(L, *r, path);
+                    lua_pop(L, 1);
+                    continue;
+                }
+
+                lua_pushstring(L, name);
+                lua_rawget(L, pending);
+
+                if (lua_isnil(L, -1))
+                {
+                    lua_pop(L, 1);
+                    lua_newtable(L);
+                    lua_pushstring(L, name);
+                    lua_pushvalue(L, -2);
+                    lua_rawset(L, pending);
+                }
+
+                lua_pushlightuserdata(L, const_cast<detail::registration*>(r));
+                lua_rawseti(L, -2, static_cast<int>(lua_rawlen(L, -2)) + 1);
+                lua_pop(L, 1);
+
+                ids.clear();
+                r->lazy_class_ids(ids);
+
+                if (ids.empty())
+                    continue;
+
+                push_child_path(L, path, name);
+
+                for (std::vector<detail::class_id>::const_iterator i = ids.begin();
+                    i != ids.end(); ++i)
+                {
+                    lua_pushvalue(L, -1);
+                    lua_rawseti(L, classes, static_cast<int>(*i));
+                }
+
+                lua_pop(L, 1);
+
+                get_class_map(L).set_lazy_classes();
+            }
+
+            lua_settop(L, table);
+        }
+
     } // namespace unnamed
     
     module_::module_(lua_State* L, char const* name = 0)
@@ -138,29 +542,124 @@ namespace luabind {
 
     void module_::operator[](scope s)
     {
-        if (m_name)
-        {
-            lua_getglobal(m_state, m_name);
+        register_module(m_state, m_name, s);
+    }
 
-            if (!lua_istable(m_state, -1))
-            {
-                lua_pop(m_state, 1);
+    compiled_module::compiled_module(scope s)
+        : m_scope(s)
+        , m_name(0)
+    {
+    }
 
-                lua_newtable(m_state);
-                lua_pushvalue(m_state, -1);
-                lua_setglobal(m_state, m_name);
-            }
-        }
-        else
+    compiled_module::compiled_module(char const* name, scope s)
+        : m_scope(s)
+        , m_name(name)
+    {
+    }
+
+    void compiled_module::register_(lua_State* L) const
+    {
+        register_module(L, m_name, m_scope);
+    }
+
+    void compiled_module::register_lazily(lua_State* L) const
+    {
+        push_module(L, m_name);
+
+        lua_createtable(L, 1, 0);
+        lua_pushvalue(L, -2);
+        lua_rawseti(L, -2, 1);
+        lua_insert(L, -2);
+
+        detail::stack_pop pop(L, 2);
+
+        ::luabind::register_lazily(L, m_scope, lua_gettop(L) - 1);
+    }
+
+    namespace detail {
+
+    LUABIND_API bool has_lazy_registrations(lua_State* L, int index)
+    {
+        if (!lua_getmetatable(L, index))
+            return false;
+
+        lua_pushliteral(L, "__index");
+        lua_rawget(L, -2);
+        bool const result = lua_tocfunction(L, -1) == &lazy_index;
+        lua_pop(L, 2);
+        return result;
+    }
+
+    LUABIND_API class_rep* materialize_class(lua_State* L, class_id id)
+    {
+        class_map const& classes = get_class_map(L);
+
+        lua_getfield(L, LUA_REGISTRYINDEX, lazy_classes);
+
+        if (lua_isnil(L, -1))
         {
-            lua_pushglobaltable(m_state);
+            lua_pop(L, 1);
+            return 0;
         }
 
-        lua_pop_stack guard(m_state);
+        int const table = lua_gettop(L);
+
+        class_rep* result = 0;
+
+        // the lookup of a namespace registers the class lazily in it,
+        // with a longer path, so it takes one step per namespace
+        for (;;)
+        {
+            lua_rawgeti(L, table, static_cast<int>(id));
+
+            if (lua_isnil(L, -1))
+                break;
 
-        s.register_(m_state);
+            lua_pushnil(L);
+            lua_rawseti(L, table, static_cast<int>(id));
+
+            int const path = lua_gettop(L);
+            int const n = static_cast<int>(lua_rawlen(L, path));
+
+# ifndef LUABIND_NO_EXCEPTIONS
+            try
+            {
+# endif
+                lua_rawgeti(L, path, 1);
+
+                for (int i = 2; i <= n && lua_istable(L, -1); ++i)
+                {
+                    lua_rawgeti(L, path, i);
+                    get_pending(L, lua_gettop(L) - 1);
+                    lua_remove(L, -2);
+                }
+# ifndef LUABIND_NO_EXCEPTIONS
+            }
+            catch (...)
+            {
+                // put the path back, so the class is registered the next
+                // time it's needed
+                lua_settop(L, path);
+                lua_rawseti(L, table, static_cast<int>(id));
+                lua_settop(L, table - 1);
+                throw;
+            }
+# endif
+
+            lua_settop(L, table);
+
+            result = classes.get(id);
+
+            if (result)
+                break;
+        }
+
+        lua_settop(L, table - 1);
+        return result;
     }
 
+    } // namespace detail
+
     struct namespace_::registration_ : detail::registration
     {
         registration_(char const* name)
@@ -191,6 +690,22 @@ namespace luabind {
             m_scope.register_(L);
         }
 
+        char const* lazy_name() const
+        {
+            return m_name;
+        }
+
+        scope const* lazy_scope() const
+        {
+            return &m_scope;
+        }
+
+        void lazy_class_ids(std::vector<detail::class_id>& ids) const
+        {
+            for (detail::registration const* r = m_scope.chain(); r; r = r->next())
+                r->lazy_class_ids(ids);
+        }
+
         char const* m_name;
         scope m_scope;
     };
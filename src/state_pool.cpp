@@ -0,0 +1,245 @@
+// Copyright Daniel Wallin 2009. Use, modification and distribution is
+// subject to the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#define LUABIND_BUILDING
+
+#include <luabind/lua_include.hpp>
+
+#include <luabind/open.hpp>
+#include <luabind/scope.hpp>
+#include <luabind/state_pool.hpp>
+#include <luabind/detail/mutex.hpp>
+
+#include <cassert>
+#include <stdexcept>
+#include <vector>
+
+#if LUA_VERSION_NUM < 502
+# define lua_pushglobaltable(L) lua_pushvalue(L, LUA_GLOBALSINDEX)
+#endif
+
+namespace luabind {
+
+namespace
+{
+  // the registry table mapping the tables reachable from the global
+  // table to their snapshots. a snapshot is a table holding a copy of
+  // the contents at 1, and the metatable at 2.
+  char const* const tables_snapshot = "luabind.tables_snapshot";
+
+  // adds the table on top of the stack, and the tables reachable from
+  // it through its keys, values and metatable, to the snapshot. the
+  // stack is left unchanged.
+  void save_table(lua_State* L, int snapshot)
+  {
+      int const table = lua_gettop(L);
+
+      lua_pushvalue(L, table);
+      lua_rawget(L, snapshot);
+      bool const saved = !lua_isnil(L, -1);
+      lua_pop(L, 1);
+
+      // namespaces that are registered lazily can't be restored, their
+      // pending registrations are done only once
+      if (saved || detail::has_lazy_registrations(L, table))
+          return;
+
+      if (!lua_checkstack(L, 8))
+          throw std::runtime_error("tables nested too deeply to be saved");
+
+      lua_createtable(L, 2, 0);
+      lua_pushvalue(L, table);
+      lua_pushvalue(L, -2);
+      lua_rawset(L, snapshot);
+
+      lua_newtable(L);
+
+      lua_pushnil(L);
+      while (lua_next(L, table))
+      {
+          lua_pushvalue(L, -2);
+          lua_pushvalue(L, -2);
+          lua_rawset(L, -5);
+
+          if (lua_istable(L, -1))
+              save_table(L, snapshot);
+
+          lua_pop(L, 1);
+
+          if (lua_istable(L, -1))
+              save_table(L, snapshot);
+      }
+
+      lua_rawseti(L, -2, 1);
+
+      if (lua_getmetatable(L, table))
+      {
+          save_table(L, snapshot);
+          lua_rawseti(L, -2, 2);
+      }
+
+      lua_settop(L, table);
+  }
+
+  void save_tables(lua_State* L)
+  {
+      lua_newtable(L);
+      int const snapshot = lua_gettop(L);
+
+      lua_pushglobaltable(L);
+      save_table(L, snapshot);
+      lua_pop(L, 1);
+
+      // the metatable shared by the strings holds the string library
+      lua_pushliteral(L, "");
+      if (lua_getmetatable(L, -1))
+      {
+          save_table(L, snapshot);
+          lua_pop(L, 1);
+      }
+      lua_pop(L, 1);
+
+      lua_setfield(L, LUA_REGISTRYINDEX, tables_snapshot);
+  }
+
+  void restore_tables(lua_State* L)
+  {
+      lua_settop(L, 0);
+      lua_getfield(L, LUA_REGISTRYINDEX, tables_snapshot);
+
+      lua_pushnil(L);
+      while (lua_next(L, 1))
+      {
+          // the table is at 2, its snapshot at 3 and the saved
+          // contents at 4
+          lua_rawgeti(L, 3, 1);
+
+          // remove the fields that weren't in the snapshot. clearing
+          // fields during the traversal is allowed.
+          lua_pushnil(L);
+          while (lua_next(L, 2))
+          {
+              lua_pop(L, 1);
+              lua_pushvalue(L, -1);
+              lua_rawget(L, 4);
+
+              if (lua_isnil(L, -1))
+              {
+                  lua_pushvalue(L, -2);
+                  lua_pushnil(L);
+                  lua_rawset(L, 2);
+              }
+
+              lua_pop(L, 1);
+          }
+
+          // and put back the ones that were
+          lua_pushnil(L);
+          while (lua_next(L, 4))
+          {
+              lua_pushvalue(L, -2);
+              lua_insert(L, -2);
+              lua_rawset(L, 2);
+          }
+
+          lua_rawgeti(L, 3, 2);
+          lua_setmetatable(L, 2);
+
+          lua_settop(L, 2);
+      }
+
+      lua_settop(L, 0);
+  }
+
+} // namespace unnamed
+
+class state_pool::impl
+{
+public:
+    detail::mutex mutex;
+    std::vector<lua_State*> idle;
+};
+
+state_pool::state_pool(initializer const& init, std::size_t size)
+  : m_init(init)
+  , m_impl(new impl)
+{
+    reserve(size);
+}
+
+state_pool::~state_pool()
+{
+    for (std::vector<lua_State*>::iterator i = m_impl->idle.begin();
+        i != m_impl->idle.end(); ++i)
+    {
+        lua_close(*i);
+    }
+}
+
+lua_State* state_pool::create() const
+{
+    lua_State* L = luaL_newstate();
+
+    try
+    {
+        open(L);
+        m_init(L);
+        lua_settop(L, 0);
+        save_tables(L);
+    }
+    catch (...)
+    {
+        lua_close(L);
+        throw;
+    }
+
+    return L;
+}
+
+lua_State* state_pool::acquire()
+{
+    {
+        detail::mutex::scoped_lock lock(m_impl->mutex);
+
+        if (!m_impl->idle.empty())
+        {
+            lua_State* L = m_impl->idle.back();
+            m_impl->idle.pop_back();
+            return L;
+        }
+    }
+
+    // the states are created without holding the lock, so the other
+    // threads can keep using the pool meanwhile
+    return create();
+}
+
+void state_pool::release(lua_State* L)
+{
+    assert(L);
+
+    restore_tables(L);
+
+    detail::mutex::scoped_lock lock(m_impl->mutex);
+    m_impl->idle.push_back(L);
+}
+
+void state_pool::reserve(std::size_t n)
+{
+    while (size() < n)
+    {
+        lua_State* L = create();
+
+        detail::mutex::scoped_lock lock(m_impl->mutex);
+        m_impl->idle.push_back(L);
+    }
+}
+
+std::size_t state_pool::size() const
+{
+    detail::mutex::scoped_lock lock(m_impl->mutex);
+    return m_impl->idle.size();
+}
+
+} // namespace luabind
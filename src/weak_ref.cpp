@@ -36,52 +36,84 @@ namespace
 {
 
   int weak_table_tag;
-  int impl_table_tag;
+
+  // the slots of the weak table that aren't in use form a list, each
+  // one holding the index of the next. the head of the list, and the
+  // number of slots ever used, are stored under these keys.
+  int const free_list = 0;
+  int const slot_count = -1;
+
+  // returns the registry reference to the weak table, the table is
+  // created the first time
+  int weak_table_ref(lua_State* L)
+  {
+      lua_pushlightuserdata(L, &weak_table_tag);
+      lua_rawget(L, LUA_REGISTRYINDEX);
+      int ref = static_cast<int>(lua_tointeger(L, -1));
+      lua_pop(L, 1);
+
+      if (ref != 0)
+          return ref;
+
+      lua_newtable(L);
+      // metatable
+      lua_createtable(L, 0, 1); // One non-sequence entry for __mode.
+      lua_pushliteral(L, "__mode");
+      lua_pushliteral(L, "v");
+      lua_rawset(L, -3);
+      // set metatable
+      lua_setmetatable(L, -2);
+
+      ref = luaL_ref(L, LUA_REGISTRYINDEX);
+
+      lua_pushlightuserdata(L, &weak_table_tag);
+      lua_pushinteger(L, ref);
+      lua_rawset(L, LUA_REGISTRYINDEX);
+
+      return ref;
+  }
+
+  // pops the value on top of the stack and stores it in a free slot
+  // of the weak table at the (absolute) index table
+  int allocate_slot(lua_State* L, int table)
+  {
+      lua_rawgeti(L, table, free_list);
+      int slot = static_cast<int>(lua_tointeger(L, -1));
+      lua_pop(L, 1);
+
+      if (slot != 0)
+      {
+          lua_rawgeti(L, table, slot);
+          lua_rawseti(L, table, free_list);
+      }
+      else
+      {
+          // luaL_ref can't be used here, the border of a weak table
+          // moves when its values are collected
+          lua_rawgeti(L, table, slot_count);
+          slot = static_cast<int>(lua_tointeger(L, -1)) + 1;
+          lua_pop(L, 1);
+          lua_pushinteger(L, slot);
+          lua_rawseti(L, table, slot_count);
+      }
+
+      lua_rawseti(L, table, slot);
+      return slot;
+  }
+
+  void release_slot(lua_State* L, int table, int slot)
+  {
+      lua_rawgeti(L, table, free_list);
+      lua_rawseti(L, table, slot);
+      lua_pushinteger(L, slot);
+      lua_rawseti(L, table, free_list);
+  }
 
 } // namespace unnamed
 
 LUABIND_API void get_weak_table(lua_State* L)
 {
-    lua_pushlightuserdata(L, &weak_table_tag);
-    lua_rawget(L, LUA_REGISTRYINDEX);
-
-    if (lua_isnil(L, -1))
-    {
-        lua_pop(L, 1);
-        lua_newtable(L);
-        // metatable
-        lua_createtable(L, 0, 1); // One non-sequence entry for __mode.
-        lua_pushliteral(L, "__mode");
-        lua_pushliteral(L, "v");
-        lua_rawset(L, -3);
-        // set metatable
-        lua_setmetatable(L, -2);
-
-        lua_pushlightuserdata(L, &weak_table_tag);
-        lua_pushvalue(L, -2);
-        lua_rawset(L, LUA_REGISTRYINDEX);
-
-    }
-
-}
-
-LUABIND_API void get_impl_table(lua_State* L)
-{
-
-    lua_pushlightuserdata(L, &impl_table_tag);
-    lua_rawget(L, LUA_REGISTRYINDEX);
-
-    if (lua_isnil(L, -1))
-    {
-        lua_pop(L, 1);
-
-        lua_newtable(L);
-        lua_pushlightuserdata(L, &impl_table_tag);
-        lua_pushvalue(L, -2);
-        lua_rawset(L, LUA_REGISTRYINDEX);
-
-    }
-
+    lua_rawgeti(L, LUA_REGISTRYINDEX, weak_table_ref(L));
 }
 
 } // namespace luabind
@@ -89,61 +121,45 @@ LUABIND_API void get_impl_table(lua_State* L)
 namespace luabind
 {
 
-    struct weak_ref::impl
-    {
-        impl(lua_State* main, lua_State* s, int index)
-            : count(0)
-            , state(main)
-            , ref(0)
-        {
-
-            get_impl_table(s);
-            lua_pushlightuserdata(s, this);
-            ref = luaL_ref(s, -2);
-            lua_pop(s, 1);
-
-            get_weak_table(s);
-            lua_pushvalue(s, index);
-            lua_rawseti(s, -2, ref);
-            lua_pop(s, 1);
-
-        }
-
-        ~impl()
-        {
-            get_impl_table(state);
-            luaL_unref(state, -1, ref);
-            lua_pop(state, 1);
-        }
-
-        int count;
-        lua_State* state;
-        int ref;
-    };
-
     weak_ref::weak_ref()
-        : m_impl(0)
+        : m_state(0)
+        , m_table(0)
+        , m_ref(0)
     {
     }
     
     weak_ref::weak_ref(lua_State* main, lua_State* L, int index)
-        : m_impl(new impl(main, L, index))
+        : m_state(main)
+        , m_table(weak_table_ref(L))
+        , m_ref(0)
     {
-        m_impl->count = 1;
+        lua_pushvalue(L, index);
+        lua_rawgeti(L, LUA_REGISTRYINDEX, m_table);
+        lua_insert(L, -2);
+        m_ref = allocate_slot(L, lua_gettop(L) - 1);
+        lua_pop(L, 1);
     }
 
     weak_ref::weak_ref(weak_ref const& other)
-        : m_impl(other.m_impl)
+        : m_state(other.m_state)
+        , m_table(other.m_table)
+        , m_ref(0)
     {
-        if (m_impl) ++m_impl->count;
+        if (!m_state) return;
+
+        lua_rawgeti(m_state, LUA_REGISTRYINDEX, m_table);
+        lua_rawgeti(m_state, -1, other.m_ref);
+        m_ref = allocate_slot(m_state, lua_gettop(m_state) - 1);
+        lua_pop(m_state, 1);
     }
 
     weak_ref::~weak_ref()
     {
-        if (m_impl && --m_impl->count == 0)
-        {
-            delete m_impl;
-        }
+        if (!m_state) return;
+
+        lua_rawgeti(m_state, LUA_REGISTRYINDEX, m_table);
+        release_slot(m_state, lua_gettop(m_state), m_ref);
+        lua_pop(m_state, 1);
     }
 
     weak_ref& weak_ref::operator=(weak_ref const& other)
@@ -154,13 +170,15 @@ namespace luabind
 
     void weak_ref::swap(weak_ref& other)
     {
-        std::swap(m_impl, other.m_impl);
+        std::swap(m_state, other.m_state);
+        std::swap(m_table, other.m_table);
+        std::swap(m_ref, other.m_ref);
     }
 
     int weak_ref::id() const
     {
-        assert(m_impl);
-		return m_impl->ref;
+        assert(m_state);
+		return m_ref;
     }
 
 	// L may not be the same pointer as
@@ -169,18 +187,17 @@ namespace luabind
 	// the same globals table.
     void weak_ref::get(lua_State* L) const
     {
-        assert(m_impl);
+        assert(m_state);
 		assert(L);
-        get_weak_table(L);
-        lua_rawgeti(L, -1, m_impl->ref);
+        lua_rawgeti(L, LUA_REGISTRYINDEX, m_table);
+        lua_rawgeti(L, -1, m_ref);
         lua_remove(L, -2);
     }
 
     lua_State* weak_ref::state() const
     {
-        assert(m_impl);
-        return m_impl->state;
+        assert(m_state);
+        return m_state;
     }
     
 } // namespace luabind
-
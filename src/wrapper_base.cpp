@@ -46,9 +46,8 @@ namespace luabind { namespace detail
 		// this (usually) means the function has not been
 		// overridden by lua, call the default implementation
 		lua_pop(L, 1);
-		obj->crep()->get_default_table(L); // push the crep table
 		lua_pushstring(L, name);
-		lua_gettable(L, -2);
-		lua_remove(L, -2); // remove the crep table
+		obj->crep()->get_member(L, lua_gettop(L), true);
+		lua_remove(L, -2); // remove the name
 	}
 }}
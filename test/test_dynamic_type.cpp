@@ -73,4 +73,16 @@ void test_main(lua_State* L)
         "x = make_unregistered()\n"
         "assert(x:g() == 3)\n"
     );
+
+    // the dynamic class is cached by the vtable after the first push,
+    // so push both types several times
+    DOSTRING(L,
+        "for i = 1, 10 do\n"
+        "  local x = make_derived()\n"
+        "  assert(x:f() == 1)\n"
+        "  local y = make_unregistered()\n"
+        "  assert(y:g() == 3)\n"
+        "  assert(y.f == nil)\n"
+        "end\n"
+    );
 }
@@ -26,6 +26,14 @@ void translate_derived_exception(lua_State* L, derived_std_exception const&)
     lua_pushstring(L, "derived_std_exception");
 }
 
+struct more_derived_exception : derived_std_exception
+{};
+
+void translate_std_exception(lua_State* L, std::exception const&)
+{
+    lua_pushstring(L, "translated std::exception");
+}
+
 void raise_my_exception()
 {
     throw my_exception();
@@ -36,6 +44,11 @@ void raise_derived()
     throw derived_std_exception();
 }
 
+void raise_more_derived()
+{
+    throw more_derived_exception();
+}
+
 void test_main(lua_State* L)
 {
     using namespace luabind;
@@ -44,7 +57,8 @@ void test_main(lua_State* L)
 
     module(L) [
         def("raise", &raise_my_exception),
-        def("raise_derived", &raise_derived)
+        def("raise_derived", &raise_derived),
+        def("raise_more_derived", &raise_more_derived)
     ];
 
     DOSTRING(L,
@@ -63,5 +77,23 @@ void test_main(lua_State* L)
         "status, msg = pcall(raise_derived)\n"
         "assert(status == false)\n"
         "assert(msg == 'derived_std_exception')\n");
+
+    DOSTRING(L,
+        "status, msg = pcall(raise_more_derived)\n"
+        "assert(status == false)\n"
+        "assert(msg == 'derived_std_exception')\n");
+
+    // the handlers registered last take precedence
+    register_exception_handler<std::exception>(&translate_std_exception);
+
+    DOSTRING(L,
+        "status, msg = pcall(raise_more_derived)\n"
+        "assert(status == false)\n"
+        "assert(msg == 'translated std::exception')\n");
+
+    DOSTRING(L,
+        "status, msg = pcall(raise)\n"
+        "assert(status == false)\n"
+        "assert(msg == 'my_exception')\n");
 }
 
@@ -23,6 +23,8 @@
 #include "test.hpp"
 #include <luabind/luabind.hpp>
 #include <luabind/adopt_policy.hpp>
+#include <luabind/no_throw_policy.hpp>
+#include <stdexcept>
 
 struct base : counted_type<base>
 {
@@ -34,6 +36,30 @@ struct base : counted_type<base>
 
 COUNTER_GUARD(base);
 
+struct derived : base
+{
+};
+
+int overloaded(base*)
+{
+    return 1;
+}
+
+int overloaded(derived*)
+{
+    return 2;
+}
+
+int overloaded(int)
+{
+    return 3;
+}
+
+int overloaded(std::string const&)
+{
+    return 4;
+}
+
 int f(int x)
 {
     return x + 1;
@@ -44,6 +70,33 @@ int f(int x, int y)
     return x + y;
 }
 
+int h(int x)
+{
+    return x * 2;
+}
+
+int raise_h(int, int)
+{
+    throw std::runtime_error("h");
+}
+
+template <class T>
+void ambiguous(T)
+{
+}
+
+int duplicate(int x)
+{
+    return x;
+}
+
+struct late_class
+{};
+
+void take_late_class(late_class*)
+{
+}
+
 base* create_base()
 {
     return new base();
@@ -90,12 +143,38 @@ void test_main(lua_State* L)
         class_<base>("base")
             .def("f", &base::f),
 
+        class_<derived, base>("derived")
+            .def(constructor<>()),
+
+        def("overloaded", (int(*)(base*)) &overloaded),
+        def("overloaded", (int(*)(derived*)) &overloaded),
+        def("overloaded", (int(*)(int)) &overloaded),
+        def("overloaded", (int(*)(std::string const&)) &overloaded),
+
 
         def("by_value", &take_by_value),
 
         def("f", (int(*)(int)) &f),
         def("f", (int(*)(int, int)) &f),
-        def("create", &create_base, adopt(return_value))
+        def("create", &create_base, adopt(return_value)),
+        def("h", &raise_h),
+        def("h", &h, no_throw),
+        def("no_throw_h", &h, no_throw),
+
+        def("ambiguous", &ambiguous<int>),
+        def("ambiguous", &ambiguous<int const&>),
+        def("ambiguous", &ambiguous<long>),
+        def("ambiguous", &ambiguous<short>),
+        def("ambiguous", &ambiguous<unsigned int>),
+        def("ambiguous", &ambiguous<unsigned long>),
+        def("ambiguous", &ambiguous<unsigned short>),
+        def("ambiguous", &ambiguous<signed char>),
+        def("ambiguous", &ambiguous<unsigned char>),
+        def("ambiguous", &ambiguous<float>),
+        def("ambiguous", &ambiguous<double>),
+        def("ambiguous", &ambiguous<long double>),
+
+        def("take_late_class", &take_late_class)
 //        def("set_functor", &set_functor)
             
 #if !(BOOST_MSVC < 1300)
@@ -114,6 +193,19 @@ void test_main(lua_State* L)
 
     DOSTRING(L, "assert(f(3, 9) == 12)");
 
+    // repeated calls with different argument types resolve to the
+    // right overload
+    DOSTRING(L,
+        "local b = create()\n"
+        "local d = derived()\n"
+        "for i = 1, 3 do\n"
+        "  assert(overloaded(b) == 1)\n"
+        "  assert(overloaded(d) == 2)\n"
+        "  assert(overloaded(1) == 3)\n"
+        "  assert(overloaded('x') == 4)\n"
+        "end\n"
+        "assert(not pcall(overloaded, {}))\n");
+
 //    DOSTRING(L, "set_functor(function(x) return x * 10 end)");
 
 //    TEST_CHECK(functor_test(20) == 200);
@@ -135,6 +227,57 @@ void test_main(lua_State* L)
         "int f(int)");
 
 
+    DOSTRING(L, "assert(h(4) == 8)");
+    DOSTRING(L, "assert(no_throw_h(4) == 8)");
+
+    DOSTRING_EXPECTED(L, "no_throw_h('incorrect')",
+        "No matching overload found, candidates:\n"
+        "int no_throw_h(int)");
+
+    // the error message names the classes registered since it was
+    // last raised
+    DOSTRING(L,
+        "for i = 1, 2 do\n"
+        "  local status, msg = pcall(take_late_class, 1)\n"
+        "  assert(msg:find('custom'))\n"
+        "end\n");
+
+    module(L)
+    [
+        class_<late_class>("late_class")
+    ];
+
+    DOSTRING_EXPECTED(L, "take_late_class(1)",
+        "No matching overload found, candidates:\n"
+        "void take_late_class(late_class*)");
+
+    // any number of overloads can be reported as ambiguous
+    DOSTRING(L,
+        "status, msg = pcall(ambiguous, 1)\n"
+        "assert(status == false)\n"
+        "assert(msg:find('^Ambiguous, candidates:\\n'))\n"
+        "local _, lines = msg:gsub('\\n', '')\n"
+        "assert(lines == 12)\n");
+
+#ifdef NDEBUG
+    // an overload registered with the same signature replaces the
+    // previous one. it's an assertion failure in debug builds.
+    module(L)
+    [
+        def("duplicate", &duplicate),
+        def("duplicate", &duplicate)
+    ];
+
+    DOSTRING(L, "assert(duplicate(3) == 3)");
+#endif
+
+    // the overloads are called with exception handling, since one of
+    // them may throw
+    DOSTRING(L,
+        "status, msg = pcall(h, 1, 2)\n"
+        "assert(status == false)\n"
+        "assert(msg == 'std::runtime_error: \\'h\\'')\n");
+
     DOSTRING(L, "function failing_fun() error('expected error message') end");
     try
     {
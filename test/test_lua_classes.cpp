@@ -133,6 +133,40 @@ struct U : T_
 	int f(int, int) { return 2; }
 };
 
+struct embedded_class : counted_type<embedded_class>
+{
+	embedded_class(int value)
+	  : value(value)
+	{}
+
+	int get() const { return value; }
+
+	int value;
+};
+
+COUNTER_GUARD(embedded_class);
+
+#ifdef BOOST_ALIGNMENT
+// needs more alignment than the userdata provides
+struct BOOST_ALIGNMENT(64) aligned_embedded_class
+{
+	bool aligned() const
+	{
+		return reinterpret_cast<std::size_t>(this) % 64 == 0;
+	}
+};
+#endif
+
+void take_embedded(embedded_class*)
+{}
+
+boost::shared_ptr<A> held_a;
+
+void hold_a(boost::shared_ptr<A> const& p)
+{
+	held_a = p;
+}
+
 void test_main(lua_State* L)
 {
 	module(L)
@@ -161,7 +195,23 @@ void test_main(lua_State* L)
 			.def(constructor<>())
 			.def("f", &T_::f)
 			.def("f", &U::f)
-			.def("g", &U::g)
+			.def("g", &U::g),
+
+		class_<embedded_class>("embedded_class")
+			.embedded()
+			.def(constructor<int>())
+			.def("get", &embedded_class::get),
+
+		def("adopt_embedded", &take_embedded, adopt(_1)),
+
+#ifdef BOOST_ALIGNMENT
+		class_<aligned_embedded_class>("aligned_embedded_class")
+			.embedded()
+			.def(constructor<>())
+			.def("aligned", &aligned_embedded_class::aligned),
+#endif
+
+		def("hold_a", &hold_a)
 	];
                               
 	DOSTRING(L, 
@@ -176,6 +226,33 @@ void test_main(lua_State* L)
 		"assert(u:f(0,0) == 2)\n"
 		"assert(u:g() == 3)\n");
 
+	// instances with members of their own, and members added to the
+	// class after the instances were created
+	DOSTRING(L,
+		"v = U()\n"
+		"v.extra = 5\n"
+		"assert(v.extra == 5)\n"
+		"assert(v:g() == 3)\n"
+		"assert(u.extra == nil)\n"
+		"function U:h() return 4 end\n"
+		"assert(u:h() == 4)\n"
+		"assert(v:h() == 4)\n");
+
+	// properties added to, and removed from, a class without bases,
+	// and other members assigned meanwhile
+	DOSTRING(L,
+		"class 'indexed'\n"
+		"function indexed:__init() end\n"
+		"function indexed:get_p() return 7 end\n"
+		"w = indexed()\n"
+		"assert(w.p == nil)\n"
+		"indexed.p = property(indexed.get_p)\n"
+		"assert(w.p == 7)\n"
+		"indexed.q = 1\n"
+		"assert(w.p == 7 and w.q == 1)\n"
+		"indexed.p = 2\n"
+		"assert(w.p == 2 and w.q == 1)\n");
+
 	DOSTRING(L,
 		"function base:fun()\n"
 		"  return 4\n"
@@ -338,6 +415,21 @@ void test_main(lua_State* L)
     );
 	own_ptr.release();
 
+	// a lua class derived from a wrapper held by a shared_ptr is
+	// kept alive by the shared_ptrs converted from it
+	DOSTRING(L,
+		"class 'held_derived' (A)\n"
+		"  function held_derived:__init() A.__init(self) end\n"
+		"  function held_derived:f() return 'held_derived:f()' end\n"
+		"hold_a(held_derived())\n"
+		"collectgarbage()\n"
+		"collectgarbage()\n");
+
+    TEST_NOTHROW(
+        TEST_CHECK(held_a->f() == "held_derived:f()")
+    );
+	held_a.reset();
+
 	// test virtual functions that are overridden by lua
     TEST_NOTHROW(
         ptr = call_function<base*>(L, "derived")
@@ -357,5 +449,98 @@ void test_main(lua_State* L)
 	DOSTRING(L,
 		"a = derived()\n"
 		"assert(a == filter(a))\n");
+
+	// members added to, or replaced in, a base class after the
+	// derived class has been created are visible through the
+	// derived class
+	DOSTRING(L,
+		"class 'lua_base'\n"
+		"  function lua_base:__init() end\n"
+		"  function lua_base:h() return 'lua_base:h()' end\n"
+		"class 'lua_derived' (lua_base)\n"
+		"  function lua_derived:__init() lua_base.__init(self) end\n"
+		"x = lua_derived()\n"
+		"assert(x:h() == 'lua_base:h()')\n"
+		"function lua_base:h() return 'new lua_base:h()' end\n"
+		"function lua_base:i() return 'lua_base:i()' end\n"
+		"assert(x:h() == 'new lua_base:h()')\n"
+		"assert(x:i() == 'lua_base:i()')\n"
+		"assert(lua_derived.i(x) == 'lua_base:i()')\n"
+		"function lua_derived:h() return 'lua_derived:h()' end\n"
+		"assert(x:h() == 'lua_derived:h()')\n"
+		"assert(lua_base():h() == 'new lua_base:h()')\n");
+
+	// a collected lua class is no longer updated by its base, and the
+	// base is kept alive by the classes deriving from it
+	DOSTRING(L,
+		"class 'collected_base'\n"
+		"  function collected_base:__init() end\n"
+		"class 'collected_derived' (collected_base)\n"
+		"  function collected_derived:__init() end\n"
+		"class 'kept_base'\n"
+		"  function kept_base:__init() end\n"
+		"  function kept_base:h() return 'kept_base:h()' end\n"
+		"class 'kept_derived' (kept_base)\n"
+		"  function kept_derived:__init() end\n"
+		"collected_derived = nil\n"
+		"kept_base = nil\n"
+		"collectgarbage()\n"
+		"collectgarbage()\n"
+		"function collected_base:h() return 'collected_base:h()' end\n"
+		"collected_base.__add = function(a, b) return 0 end\n"
+		"assert(collected_base():h() == 'collected_base:h()')\n"
+		"assert(kept_derived():h() == 'kept_base:h()')\n");
+
+	// the constructor is looked up again when it's replaced
+	DOSTRING(L,
+		"class 'reinit'\n"
+		"  function reinit:__init() self.x = 1 end\n"
+		"assert(reinit().x == 1)\n"
+		"function reinit:__init() self.x = 2 end\n"
+		"assert(reinit().x == 2)\n");
+
+	// objects constructed in the instance, also as the base of a lua
+	// class. they can't be adopted.
+	DOSTRING(L,
+		"class 'embedded_derived' (embedded_class)\n"
+		"  function embedded_derived:__init(x) embedded_class.__init(self, x * 2) end\n"
+		"  function embedded_derived:twice() return self:get() * 2 end\n"
+		"e = embedded_class(3)\n"
+		"assert(e:get() == 3)\n"
+		"d = embedded_derived(4)\n"
+		"assert(d:get() == 8)\n"
+		"assert(d:twice() == 16)\n"
+		"assert(not pcall(adopt_embedded, e))\n"
+		"assert(e:get() == 3)\n"
+		"e = nil\n"
+		"d = nil\n"
+		"collectgarbage()\n"
+		"collectgarbage()\n");
+
+	TEST_CHECK(embedded_class::count == 0);
+
+#ifdef BOOST_ALIGNMENT
+	// the embedded storage is aligned for the object
+	DOSTRING(L,
+		"for i = 1, 8 do\n"
+		"  assert(aligned_embedded_class():aligned())\n"
+		"end\n");
+#endif
+
+	// __finalize is called for lua classes defining it, and only for them
+	DOSTRING(L,
+		"finalized = 0\n"
+		"class 'finalized_class'\n"
+		"  function finalized_class:__init() end\n"
+		"  function finalized_class:__finalize() finalized = finalized + 1 end\n"
+		"class 'not_finalized_class'\n"
+		"  function not_finalized_class:__init() end\n"
+		"x = finalized_class()\n"
+		"y = not_finalized_class()\n"
+		"x = nil\n"
+		"y = nil\n"
+		"collectgarbage()\n"
+		"collectgarbage()\n"
+		"assert(finalized == 1)\n");
 }
 
@@ -31,6 +31,7 @@
 #include <boost/lexical_cast.hpp>
 
 #include <utility>
+#include <vector>
 
 using namespace luabind;
 
@@ -238,6 +239,45 @@ void test_argument(lua_State* L)
         "assert(with_table_argument(x, 'foo') == 1)\n"
         "assert(with_table_argument(x, 'bar') == 2)\n"
     );
+
+    {
+        LUABIND_CHECK_STACK(L);
+
+        lua_getglobal(L, "x");
+        lua_pushnil(L);
+
+        stack_object table(from_stack(L, -2));
+        TEST_CHECK(table.index() == lua_gettop(L) - 1);
+        TEST_CHECK(type(table) == LUA_TTABLE);
+        TEST_CHECK(object_cast<int>(table["bar"]) == 2);
+
+        lua_pop(L, 2);
+    }
+}
+
+void test_move(lua_State* L)
+{
+#ifndef BOOST_NO_CXX11_RVALUE_REFERENCES
+    LUABIND_CHECK_STACK(L);
+
+    object x(L, 5);
+    object y(std::move(x));
+
+    TEST_CHECK(!x.is_valid());
+    TEST_CHECK(object_cast<int>(y) == 5);
+
+    object z(L, 6);
+    z = std::move(y);
+
+    TEST_CHECK(object_cast<int>(z) == 5);
+
+    std::vector<object> v;
+    for (int i = 0; i < 100; ++i)
+        v.push_back(object(L, i));
+
+    TEST_CHECK(object_cast<int>(v[0]) == 0);
+    TEST_CHECK(object_cast<int>(v[99]) == 99);
+#endif
 }
 
 void test_bool_convertible(lua_State* L)
@@ -456,5 +496,6 @@ void test_main(lua_State* L)
     test_explicit_conversions(L);
     test_argument(L);
     test_bool_convertible(L);
+    test_move(L);
 }
 
@@ -24,6 +24,8 @@
 #include <luabind/luabind.hpp>
 #include <luabind/operator.hpp>
 #include <iosfwd>
+#include <ostream>
+#include <string>
 
 struct operator_tester : counted_type<operator_tester>
 {
@@ -117,6 +119,44 @@ struct len_tester
 	int len_;
 };
 
+struct format_tester
+{
+	format_tester(int value, bool hex, int width)
+	  : value(value)
+	  , hex(hex)
+	  , width(width)
+	{}
+
+	int value;
+	bool hex;
+	int width;
+};
+
+std::ostream& operator<<(std::ostream& os, format_tester const& x)
+{
+	if (x.hex)
+		os << std::hex;
+	if (x.width > 0)
+		os << std::string(x.width, '-');
+	return os << x.value;
+}
+
+struct nested_tester
+{
+	nested_tester(luabind::object const& value)
+	  : value(value)
+	{}
+
+	luabind::object value;
+};
+
+// writes a lua object, which uses the lua stack, after more than a
+// lua buffer of output
+std::ostream& operator<<(std::ostream& os, nested_tester const& x)
+{
+	return os << std::string(20000, '-') << x.value << '|';
+}
+
 void test_main(lua_State* L)
 {
 	using namespace luabind;
@@ -157,7 +197,15 @@ void test_main(lua_State* L)
 
 		class_<len_tester>("len_tester")
 			.def(constructor<int>())
-			.def("__len", &len_tester::len)
+			.def("__len", &len_tester::len),
+
+		class_<format_tester>("format_tester")
+			.def(constructor<int, bool, int>())
+			.def(tostring(const_self)),
+
+		class_<nested_tester>("nested_tester")
+			.def(constructor<luabind::object const&>())
+			.def(tostring(const_self))
 	];
 	
 	DOSTRING(L, "test = operator_tester()");
@@ -165,6 +213,19 @@ void test_main(lua_State* L)
 	DOSTRING(L, "test3 = operator_tester3()");
 
 	DOSTRING(L, "assert(tostring(test) == 'operator_tester')");
+
+	// the format set by one call doesn't leak into the next, and
+	// strings longer than the lua buffer are formatted
+	DOSTRING(L,
+		"assert(tostring(format_tester(255, true, 0)) == 'ff')\n"
+		"assert(tostring(format_tester(255, false, 0)) == '255')\n"
+		"assert(tostring(format_tester(1, false, 20000)) == "
+		"  string.rep('-', 20000) .. '1')\n");
+
+	// operator<< may use the lua stack
+	DOSTRING(L,
+		"assert(tostring(nested_tester('value')) == "
+		"  string.rep('-', 20000) .. 'value|')\n");
 	
 	DOSTRING(L, "assert(test() == 3.5)");
 	DOSTRING(L, "assert(test(5) == 2.5 + 5)");
@@ -219,5 +280,48 @@ void test_main(lua_State* L)
 	DOSTRING(L,
 		"x = len_tester(3)\n"
 		"assert(#x == 3)");
+
+	// operators added to a class after its instances are created, and
+	// operators inherited by lua classes
+	DOSTRING(L,
+		"class 'my_derived' (my_class)\n"
+		"function my_derived:__init(a)\n"
+		"	my_class.__init(self, a)\n"
+		"end\n"
+		"a = my_class(3)\n"
+		"e = my_derived(4)\n"
+		"assert((e + a).val == 7)\n"
+		"function my_class:__unm()\n"
+		"	return my_class(-self.val)\n"
+		"end\n"
+		"assert((-a).val == -3)\n"
+		"assert((-e).val == -4)\n"
+		"function my_derived:__add(rhs)\n"
+		"	return 'my_derived'\n"
+		"end\n"
+		"assert(e + a == 'my_derived')\n"
+		"assert((a + e).val == 7)\n");
+
+	DOSTRING(L,
+		"class 'len_derived' (len_tester)\n"
+		"function len_derived:__init(n)\n"
+		"	len_tester.__init(self, n)\n"
+		"end\n"
+		"assert(#len_derived(5) == 5)\n");
+
+	// operators assigned to a single instance are only used for it
+	DOSTRING(L,
+		"x = operator_tester()\n"
+		"x.__add = function(lhs, rhs) return 'x' end\n"
+		"x.__tostring = function(self) return 'x' end\n"
+		"assert(x + 1 == 'x')\n"
+		"assert(tostring(x) == 'x')\n"
+		"assert(-x == 46)\n"
+		"assert(test + 1 == 1 + 1)\n"
+		"assert(tostring(test) == 'operator_tester')\n"
+		"local m = my_class(7)\n"
+		"m.__unm = function(self) return 'm' end\n"
+		"assert(-m == 'm')\n"
+		"assert((-my_class(7)).val == -7)\n");
 }
 
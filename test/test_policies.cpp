@@ -58,6 +58,7 @@ struct policies_test_class
 		delete p;
 	}
 	const policies_test_class* internal_ref() { return this; }
+	void depend_on(policies_test_class*) {}
 	policies_test_class* self_ref()
 	{ return this; }
 
@@ -123,6 +124,7 @@ void test_main(lua_State* L)
 			.def("f", &policies_test_class::f, adopt(_2))
 			.def("make", &policies_test_class::make, adopt(return_value))
 			.def("internal_ref", &policies_test_class::internal_ref, dependency(result, _1))
+			.def("depend_on", &policies_test_class::depend_on, dependency(_1, _2))
 			.def("self_ref", &policies_test_class::self_ref, return_reference_to(_1)),
 
 		def("out_val", &out_val, pure_out_value(_1)),
@@ -199,6 +201,33 @@ void test_main(lua_State* L)
 
 	TEST_CHECK(policies_test_class::count == 1);
 
+	// nil dependencies are ignored, and don't mix up the dependencies
+	// of different objects
+	DOSTRING(L,
+		"a = test()\n"
+		"b = test()\n"
+		"c = test()\n"
+		"d = test()\n"
+		"a:depend_on(nil)\n"
+		"a:depend_on(b)\n"
+		"c:depend_on(nil)\n"
+		"c:depend_on(d)\n"
+		"b = nil\n"
+		"d = nil\n"
+		"collectgarbage()\n"
+		"collectgarbage()");
+
+	// b and d are kept alive by a and c
+	TEST_CHECK(policies_test_class::count == 5);
+
+	DOSTRING(L,
+		"a = nil\n"
+		"c = nil\n"
+		"collectgarbage()\n"
+		"collectgarbage()");
+
+	TEST_CHECK(policies_test_class::count == 1);
+
 	// adopt
 	DOSTRING(L, "a = test()");
 
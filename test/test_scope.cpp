@@ -49,6 +49,95 @@ struct test_class2 : counted_type<test_class2>
 COUNTER_GUARD(test_class);
 COUNTER_GUARD(test_class2);
 
+struct lazy_base
+{
+	int f() const { return 1; }
+};
+
+struct lazy_derived : lazy_base
+{};
+
+struct shadowed_base
+{};
+
+struct shadowed_derived : shadowed_base
+{};
+
+struct failing_base
+{};
+
+struct failing_derived : failing_base
+{};
+
+lazy_derived* make_derived()
+{
+	static lazy_derived x;
+	return &x;
+}
+
+failing_derived* make_failing()
+{
+	static failing_derived x;
+	return &x;
+}
+
+luabind::compiled_module const& lazy_module()
+{
+	using namespace luabind;
+
+	static compiled_module m("lazy",
+	(
+		def("make_derived", &make_derived),
+
+		class_<lazy_base>("lazy_base")
+			.def("f", &lazy_base::f),
+
+		namespace_("inner")
+		[
+			class_<lazy_derived, lazy_base>("lazy_derived")
+		],
+
+		namespace_("inner")
+		[
+			def("g", &g)
+		]
+	));
+
+	return m;
+}
+
+luabind::compiled_module const& shadowed_module()
+{
+	using namespace luabind;
+
+	static compiled_module m("shadowed",
+	(
+		class_<shadowed_base>("shadowed_base"),
+		class_<shadowed_derived, shadowed_base>("shadowed_derived")
+	));
+
+	return m;
+}
+
+luabind::compiled_module const& failing_module()
+{
+	using namespace luabind;
+
+	static compiled_module m("failing",
+	(
+		def("make_failing", &make_failing),
+
+		class_<failing_base>("failing_base"),
+
+		namespace_("inner")
+		[
+			class_<failing_derived, failing_base>("failing_derived")
+		]
+	));
+
+	return m;
+}
+
 void test_main(lua_State* L)
 {
 	using namespace luabind;
@@ -115,5 +204,52 @@ void test_main(lua_State* L)
 	DOSTRING(L, "assert(test.inner.g(7) == 5)");
 	DOSTRING(L, "assert(test.inner.f(4) == 3)");
 	DOSTRING(L, "assert(test.inner.h() == 6)");
+
+	lazy_module().register_lazily(L);
+
+	DOSTRING(L,
+		"assert(rawget(lazy, 'lazy_base') == nil)\n"
+		"assert(rawget(lazy, 'inner') == nil)\n"
+		"assert(lazy.make_derived ~= nil)");
+
+	// pushing an object registers its class, and its base
+	DOSTRING(L,
+		"x = lazy.make_derived()\n"
+		"assert(x:f() == 1)\n"
+		"assert(rawget(lazy, 'inner') ~= nil)\n"
+		"assert(rawget(lazy, 'lazy_base') ~= nil)\n"
+		"assert(rawget(lazy.inner, 'lazy_derived') ~= nil)");
+
+	// both registrations of the namespace are done
+	DOSTRING(L, "assert(lazy.inner.g() == 4)");
+	DOSTRING(L, "assert(lazy.missing == nil)");
+
+	shadowed_module().register_lazily(L);
+
+	// a class whose base can't be found isn't registered, and is
+	// looked up again the next time
+	DOSTRING(L,
+		"shadowed.shadowed_base = 1\n"
+		"local function get() return shadowed.shadowed_derived end\n"
+		"local status, msg = pcall(get)\n"
+		"assert(not status and msg:find('not registered'))\n"
+		"assert(not pcall(get))\n"
+		"shadowed.shadowed_base = nil\n"
+		"assert(shadowed.shadowed_base ~= nil)\n"
+		"assert(get() ~= nil)");
+
+	failing_module().register_lazily(L);
+
+	// the class of a pushed object is registered without running Lua
+	// code, and an error is raised from the function, after the C++
+	// frames have been unwound
+	DOSTRING(L,
+		"failing.failing_base = 1\n"
+		"local status, msg = pcall(failing.make_failing)\n"
+		"assert(not status and msg:find('not registered'))\n"
+		"failing.failing_base = nil\n"
+		"assert(failing.failing_base ~= nil)\n"
+		"assert(failing.make_failing() ~= nil)\n"
+		"assert(rawget(failing.inner, 'failing_derived') ~= nil)");
 }
 
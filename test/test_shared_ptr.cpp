@@ -25,6 +25,33 @@ boost::shared_ptr<X> filter(boost::shared_ptr<X> const& p)
     return p;
 }
 
+struct Y
+{};
+
+boost::shared_ptr<X> x_instance(new X(2));
+boost::shared_ptr<Y> y_instance(new Y);
+
+boost::shared_ptr<X> get_x()
+{
+    return x_instance;
+}
+
+// true if p shares the ownership of x_instance
+bool owned_by_x_instance(boost::shared_ptr<X> const& p)
+{
+    return !(p < x_instance) && !(x_instance < p);
+}
+
+boost::shared_ptr<Y> get_y()
+{
+    return y_instance;
+}
+
+boost::shared_ptr<Y const> get_const_y()
+{
+    return y_instance;
+}
+
 void test_main(lua_State* L)
 {
     using namespace luabind;
@@ -33,7 +60,14 @@ void test_main(lua_State* L)
         class_<X>("X")
             .def(constructor<int>()),
         def("get_value", &get_value),
-        def("filter", &filter)
+        def("filter", &filter),
+
+        class_<Y>("Y")
+            .identity_cache(),
+        def("get_x", &get_x),
+        def("owned_by_x_instance", &owned_by_x_instance),
+        def("get_y", &get_y),
+        def("get_const_y", &get_const_y)
     ];
 
     DOSTRING(L,
@@ -44,4 +78,26 @@ void test_main(lua_State* L)
     DOSTRING(L,
         "assert(x == filter(x))\n"
     );
+
+    DOSTRING(L,
+        "assert(not rawequal(get_x(), get_x()))\n"
+        "assert(rawequal(get_y(), get_y()))\n"
+        "assert(rawequal(get_const_y(), get_const_y()))\n"
+        "assert(not rawequal(get_y(), get_const_y()))\n"
+    );
+
+    // const and non-const instances don't evict each other
+    DOSTRING(L,
+        "local y = get_y()\n"
+        "local const_y = get_const_y()\n"
+        "for i = 1, 3 do\n"
+        "  assert(rawequal(get_y(), y))\n"
+        "  assert(rawequal(get_const_y(), const_y))\n"
+        "end\n"
+    );
+
+    DOSTRING(L,
+        "assert(owned_by_x_instance(get_x()))\n"
+        "assert(not owned_by_x_instance(X(2)))\n"
+    );
 }
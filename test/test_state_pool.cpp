@@ -0,0 +1,186 @@
+// Copyright (c) 2009 Daniel Wallin and Arvid Norberg
+
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF
+// ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED
+// TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+// SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+// ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+// ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+// OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "test.hpp"
+#include <luabind/lua_include.hpp>
+
+#ifndef LUABIND_CPLUSPLUS_LUA
+extern "C"
+{
+#endif
+# include <lualib.h>
+#ifndef LUABIND_CPLUSPLUS_LUA
+}
+#endif
+
+#include <luabind/luabind.hpp>
+#include <luabind/state_pool.hpp>
+#include <boost/bind.hpp>
+
+namespace
+{
+
+  int initialized = 0;
+
+  int f(int x)
+  {
+      return x + 1;
+  }
+
+  void initialize(lua_State* L)
+  {
+      using namespace luabind;
+
+      ++initialized;
+
+      luaL_openlibs(L);
+
+      module(L)
+      [
+          def("f", &f)
+      ];
+
+      module(L, "ns")
+      [
+          def("g", &f)
+      ];
+
+      DOSTRING(L, "x = 1");
+  }
+
+  struct X
+  {};
+
+  struct Y : X
+  {};
+
+  void test_compiled_module()
+  {
+      using namespace luabind;
+
+      compiled_module m("test",
+      (
+          def("f", &f),
+
+          class_<X>("X")
+              .def(constructor<>())
+              .enum_("values")
+              [
+                  value("a", 1),
+                  value("b", 2)
+              ],
+
+          class_<Y, X>("Y")
+      ));
+
+      state_pool pool(boost::bind(&compiled_module::register_, &m, _1));
+
+      scoped_state L1(pool);
+      scoped_state L2(pool);
+
+      // the registrations are used for both states
+      lua_State* states[] = { L1, L2 };
+
+      for (int i = 0; i < 2; ++i)
+      {
+          lua_State* L = states[i];
+
+          DOSTRING(L,
+              "x = test.X()\n"
+              "y = test.f(test.X.b)");
+
+          TEST_CHECK(object_cast<int>(globals(L)["test"]["X"]["a"]) == 1);
+
+          // the constants of the bases are looked up through them
+          TEST_CHECK(object_cast<int>(globals(L)["test"]["Y"]["b"]) == 2);
+          TEST_CHECK(object_cast<int>(globals(L)["y"]) == 3);
+      }
+  }
+
+} // namespace unnamed
+
+void test_main(lua_State*)
+{
+    using namespace luabind;
+
+    state_pool pool(&initialize, 1);
+
+    TEST_CHECK(initialized == 1);
+    TEST_CHECK(pool.size() == 1);
+
+    lua_State* L = pool.acquire();
+    TEST_CHECK(pool.size() == 0);
+
+    DOSTRING(L,
+        "x = f(x)\n"
+        "y = 3\n"
+        "f = nil\n"
+        "string.x = 1\n"
+        "table.insert = nil\n"
+        "package.loaded.m = {}\n"
+        "ns.g = nil\n"
+        "ns.h = 1\n"
+        "setmetatable(ns, {})\n");
+
+    TEST_CHECK(object_cast<int>(globals(L)["x"]) == 2);
+
+    pool.release(L);
+    TEST_CHECK(pool.size() == 1);
+
+    {
+        scoped_state S(pool);
+
+        // the state is reused, with the globals it had after
+        // initialization
+        TEST_CHECK(static_cast<lua_State*>(S) == L);
+        TEST_CHECK(initialized == 1);
+        TEST_CHECK(object_cast<int>(globals(S)["x"]) == 1);
+        TEST_CHECK(type(globals(S)["y"]) == LUA_TNIL);
+        TEST_CHECK(type(globals(S)["f"]) == LUA_TFUNCTION);
+
+        // and so do the tables reachable from them
+        DOSTRING(S,
+            "assert(string.x == nil)\n"
+            "assert(('').x == nil)\n"
+            "assert(type(table.insert) == 'function')\n"
+            "assert(package.loaded.m == nil)\n"
+            "assert(ns.g(1) == 2)\n"
+            "assert(ns.h == nil)\n"
+            "assert(getmetatable(ns) == nil)\n");
+
+        DOSTRING(S, "x = f(x)");
+
+        // there is no idle state left, a new one is created
+        scoped_state S2(pool);
+        TEST_CHECK(static_cast<lua_State*>(S2) != L);
+        TEST_CHECK(initialized == 2);
+        TEST_CHECK(object_cast<int>(globals(S2)["x"]) == 1);
+    }
+
+    TEST_CHECK(pool.size() == 2);
+
+    pool.reserve(3);
+    TEST_CHECK(initialized == 3);
+    TEST_CHECK(pool.size() == 3);
+
+    test_compiled_module();
+}